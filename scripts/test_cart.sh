@@ -48,4 +48,30 @@ fi
 rm -rf temp.8o
 rm -rf temp.gif
 
+# do encoded carts carry a rom which matches their source?
+$COMPILER carts/test_tiny.8o temp.ch8
+$COMPILER carts/test_tiny.8o temp.gif
+$COMPILER temp.gif temp2.ch8
+if ! cmp -s temp.ch8 temp2.ch8; then
+	echo "rom carried by an encoded cart doesn't match its source."
+	exit 1
+fi
+rm -rf temp.ch8 temp2.ch8
+rm -rf temp.gif
+
+# carts whose source uses :include carry no rom, so edits to the included files are seen
+dir=$(mktemp -d)
+printf ': main\n  :include "lib.8o"\n' > $dir/main.8o
+echo "0x01" > $dir/lib.8o
+$COMPILER $dir/main.8o $dir/cart.gif
+echo "0x02" > $dir/lib.8o
+$COMPILER $dir/main.8o $dir/main.ch8
+$COMPILER $dir/cart.gif $dir/cart.ch8
+if ! cmp -s $dir/main.ch8 $dir/cart.ch8; then
+	echo "a cart with :include ran a stale rom after its included file changed."
+	rm -rf $dir
+	exit 1
+fi
+rm -rf $dir
+
 echo "all cartridge tests passed."
@@ -57,6 +57,45 @@ for filename in tests/*.8o; do
 		exit 1
 	fi
 done
+
+# source read from a pipe compiles the same as the mapped file
+rm -rf temp.ch8
+cat tests/enchilada.8o | $COMPILER - temp.ch8
+if ! cmp -s temp.ch8 tests/enchilada.ch8; then
+	echo "reference binary doesn't match for standard input."
+	exit 1
+fi
+
+# programs compiled with -O -P -D match their optimized references
+for filename in tests/optimize/*.8o; do
+	rm -rf temp.ch8
+	$COMPILER "$filename" temp.ch8 -O -P -D 2> /dev/null
+	if ! cmp -s temp.ch8 ${filename%.*}.ch8; then
+		echo "reference binary doesn't match for ${filename} with -O -P -D:"
+		cmp -lb ${filename%.*}.ch8 temp.ch8 | head -n 10
+		exit 1
+	fi
+done
+# a large :include is tokenized in linear time, and compiles as if pasted inline
+big=$(mktemp -d)
+yes ':alias x v1' | head -n 60000 > $big/big.8o
+printf ': main\n  :include "big.8o"\n  v1 := 2\n  loop again\n' > $big/main.8o
+cat $big/big.8o > $big/inline.8o
+printf ': main\n  v1 := 2\n  loop again\n' >> $big/inline.8o
+rm -rf temp.ch8
+if ! timeout 5 $COMPILER $big/main.8o temp.ch8; then
+	echo "compiling a 180000 token :include took too long."
+	rm -rf $big
+	exit 1
+fi
+$COMPILER $big/inline.8o $big/inline.ch8
+if ! cmp -s temp.ch8 $big/inline.ch8; then
+	echo "a large :include doesn't match the same source pasted inline."
+	rm -rf $big
+	exit 1
+fi
+rm -rf $big
+
 echo "all compiler tests passed."
 rm -rf temp.ch8
 rm -rf temp.err
@@ -0,0 +1,33 @@
+#!/bin/bash
+# smoke test for octo-fuzz: it must find both of the
+# crashes planted in tests/fuzz_target.8o, and the
+# saved traces must reproduce them.
+
+if [ $# -eq 0 ]; then
+	echo "usage: ${0} <path-to-octo-fuzz>"
+	exit 1
+else
+	FUZZER=$1
+	echo "running tests against ${FUZZER}..."
+fi
+
+rm -rf temp.fuzz
+mkdir temp.fuzz
+$FUZZER tests/fuzz_target.ch8 -n 50 -b 64 -j 2 -s 1 -o temp.fuzz > temp.fuzz/log
+for crash in "Call Stack Overflow" "Write to 0x0000-0x00FF"; do
+	trace=$(grep -l "^# ${crash}" temp.fuzz/*.keys | head -n 1)
+	if [ -z "$trace" ]; then
+		echo "fuzzer did not find: ${crash}"
+		cat temp.fuzz/log
+		rm -rf temp.fuzz
+		exit 1
+	fi
+	if ! $FUZZER tests/fuzz_target.ch8 -r "$trace" | grep -q "$crash"; then
+		echo "trace ${trace} does not reproduce: ${crash}"
+		cat "$trace"
+		rm -rf temp.fuzz
+		exit 1
+	fi
+done
+echo "all fuzzer tests passed."
+rm -rf temp.fuzz
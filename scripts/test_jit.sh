@@ -0,0 +1,52 @@
+#!/bin/bash
+# differential tests for octo-jit: every reference binary
+# must behave identically under the block translator, with
+# and without native code, and the reference interpreter.
+
+if [ $# -eq 0 ]; then
+	echo "usage: ${0} <path-to-octo-jit>"
+	exit 1
+else
+	RUNNER=$1
+	echo "running tests against ${RUNNER}..."
+fi
+
+for filename in tests/*.ch8; do
+	for quirks in "" "-q"; do
+		for native in "" "-n"; do
+			if ! $RUNNER "$filename" -d -f 300 -t 1000 $quirks $native > temp.log; then
+				echo "translator diverged for ${filename} ${quirks} ${native}:"
+				cat temp.log
+				rm -rf temp.log
+				exit 1
+			fi
+		done
+	done
+done
+
+# batch runs must not depend upon how instances are spread over
+# threads, and resetting a batch must reproduce its first run
+for filename in tests/*.ch8; do
+	serial=$($RUNNER "$filename" -b 64 -j 1 -f 120 | sed 's/ on .* threads//;s/ in .* Mips)//')
+	threaded=$($RUNNER "$filename" -b 64 -j 4 -f 120 -r 3 | sed 's/ on .* threads//;s/ in .* Mips)//')
+	if [ "$serial" != "$threaded" ]; then
+		echo "batch results depend on threads or resets for ${filename}:"
+		echo "$serial"
+		echo "$threaded"
+		rm -rf temp.log
+		exit 1
+	fi
+done
+# watchpoints must halt both the interpreter and the translator
+# on the first watched access
+for test in "watch_write:Write 0x00 to watched 0x021D" "watch_read:Read from watched 0x021A"; do
+	for mode in "" "-i"; do
+		if ! $RUNNER "tests/${test%%:*}.8o" $mode | grep -q "halted: ${test#*:}$"; then
+			echo "watchpoint was not reported for ${test%%:*} ${mode}:"
+			$RUNNER "tests/${test%%:*}.8o" $mode
+			exit 1
+		fi
+	done
+done
+echo "all translator tests passed."
+rm -rf temp.log
@@ -0,0 +1,34 @@
+#!/bin/bash
+# round trip for instruction traces: octo-jit must write the
+# last instructions before tests/trace_overflow.8o halts, and
+# octo-cli must decode them against the program's labels.
+
+if [ $# -lt 2 ]; then
+	echo "usage: ${0} <path-to-octo-jit> <path-to-octo-cli>"
+	exit 1
+else
+	RUNNER=$1
+	DECODER=$2
+	echo "running tests against ${RUNNER} and ${DECODER}..."
+fi
+
+$RUNNER tests/trace_overflow.ch8 -o temp.trace > /dev/null
+$DECODER -t temp.trace tests/trace_overflow.8o > temp.log
+for expected in "^# 39 instructions traced, the last 39 shown. halted: Call Stack Overflow$" \
+                " 0x020A  2206  0x0000  00  00  :call 0x206  *; recurse$" \
+                " 0x0208  8104  0x0000  51  00  v1 += v0  *; recurse$"; do
+	if ! grep -q "$expected" temp.log; then
+		echo "decoded trace does not match: ${expected}"
+		cat temp.log
+		rm -rf temp.trace temp.log
+		exit 1
+	fi
+done
+if [ "$(tail -n 1 temp.log | awk '{print $1}')" != "38" ]; then
+	echo "decoded trace does not end with the overflowing call:"
+	cat temp.log
+	rm -rf temp.trace temp.log
+	exit 1
+fi
+echo "all trace tests passed."
+rm -rf temp.trace temp.log
@@ -0,0 +1,257 @@
+/**
+*
+*  octo_batch.h
+*
+*  runs many instances of one program side by side, for
+*  automated play-testing. every instance starts as a copy
+*  of a model emulator (so the ROM is loaded and the core
+*  initialized only once) with its own random seed, and an
+*  input callback supplies keys per instance and frame.
+*  the instances are spread over a small pool of threads,
+*  and advance in lockstep: each call to octo_batch_run()
+*  returns when every instance has completed the requested
+*  number of frames. threads use pthreads where available,
+*  and otherwise the batch runs on the calling thread.
+*  octo_batch_reset() returns every instance to the model,
+*  and octo_batch_cover() enables a per-instance bitmap of
+*  the addresses each instance has executed.
+*
+*  where mmap() is available, the model is written once to
+*  an unlinked temporary file and every instance is a private
+*  mapping of it, so the instances share the pages of the
+*  model (the rom, the fonts and whatever ram is never
+*  written) and the system copies a page for an instance
+*  only when it first writes there. a reset maps the model
+*  over the instance again, dropping those copies. otherwise
+*  the instances are copies of the model, and a reset copies
+*  back only the ram pages each one has written.
+*
+*  octo_batch_get() finds an instance, as they are not laid
+*  out at intervals of sizeof(octo_emulator). the model may
+*  not change once the batch is created, except for its seed.
+*
+**/
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define OCTO_BATCH_PTHREADS
+#define OCTO_BATCH_SHARED
+#endif
+
+#define OCTO_BATCH_CHUNK 8           // instances claimed by a thread at a time
+#define OCTO_BATCH_COVER (64*1024/8) // bytes of coverage bitmap per instance
+#define OCTO_BATCH_ALIGN (64*1024)   // instances start on a page boundary, whatever the page size
+
+typedef void (*octo_batch_input)(octo_emulator*e,int index,int frame,void*user);
+
+typedef struct {
+  octo_emulator model;   // the state every instance starts from
+  char*e;                // instances, stride bytes apart
+  size_t stride;
+  int shared;            // file descriptor of the model's image, if instances map it, or -1
+  int count;             // number of instances
+  int threads;           // threads working on the batch, including the caller
+  int frame;             // frames completed by every instance
+  uint8_t*cover;         // optional bitmaps of executed addresses, per instance
+
+  // the current job
+  int frames, next, busy, generation, quit;
+  octo_batch_input input;
+  void*user;
+
+#ifdef OCTO_BATCH_PTHREADS
+  pthread_t*pool;
+  pthread_mutex_t lock;
+  pthread_cond_t start, done;
+#endif
+} octo_batch;
+
+/**
+*
+*  Instances
+*
+**/
+
+octo_emulator* octo_batch_get(octo_batch*b,int k){return (octo_emulator*)(b->e+(size_t)k*b->stride);}
+
+void octo_batch_frame(octo_emulator*e,uint8_t*cover){
+  if(e->halt)return;
+  if(e->wait)for(int k=0;k<16;k++)if(e->keys[k]){e->v[(int)e->wait_reg]=k,e->wait=0;break;}
+  for(int z=0;z<e->options.tickrate&&!e->halt&&!e->wait;z++){
+    if(e->options.q_vblank&&(e->ram[e->pc]&0xF0)==0xD0)z=e->options.tickrate;
+    int pc=e->pc;
+    if(cover)cover[pc>>3]|=1<<(pc&7);
+    octo_emulator_instruction(e);
+    z+=octo_emulator_idle(e,pc,e->options.tickrate-z-1);
+  }
+  if(e->dt>0)e->dt--;
+  if(e->st>0)e->st--,e->had_sound=1;
+}
+
+void octo_batch_work(octo_batch*b){
+  while(1){
+#ifdef OCTO_BATCH_PTHREADS
+    pthread_mutex_lock(&b->lock);
+#endif
+    int z=b->next;
+    b->next+=OCTO_BATCH_CHUNK;
+#ifdef OCTO_BATCH_PTHREADS
+    pthread_mutex_unlock(&b->lock);
+#endif
+    if(z>=b->count)return;
+    for(int k=z;k<z+OCTO_BATCH_CHUNK&&k<b->count;k++){
+      octo_emulator*e=octo_batch_get(b,k);
+      for(int f=0;f<b->frames&&!e->halt;f++){
+        if(b->input)b->input(e,k,b->frame+f,b->user);
+        octo_batch_frame(e,b->cover?b->cover+k*OCTO_BATCH_COVER:NULL);
+      }
+    }
+  }
+}
+
+/**
+*
+*  Thread Pool
+*
+**/
+
+#ifdef OCTO_BATCH_PTHREADS
+void* octo_batch_worker(void*arg){
+  octo_batch*b=arg;
+  int seen=0;
+  pthread_mutex_lock(&b->lock);
+  while(1){
+    while(b->generation==seen&&!b->quit)pthread_cond_wait(&b->start,&b->lock);
+    if(b->quit)break;
+    seen=b->generation;
+    pthread_mutex_unlock(&b->lock);
+    octo_batch_work(b);
+    pthread_mutex_lock(&b->lock);
+    if(--b->busy==0)pthread_cond_signal(&b->done);
+  }
+  pthread_mutex_unlock(&b->lock);
+  return NULL;
+}
+#endif
+
+void octo_batch_seed(octo_batch*b,int k){
+  octo_emulator*e=octo_batch_get(b,k);
+  e->seed=(b->model.seed+k+1)*2654435761u;
+  if(e->seed==0)e->seed=1;
+}
+
+#ifdef OCTO_BATCH_SHARED
+int octo_batch_image(octo_batch*b){
+  // an unlinked file holding the model, padded to the stride, or -1
+  static int made=0;
+  char*dirs[]={"/dev/shm","/tmp"}, path[64];
+  for(int d=0;d<2;d++){
+    snprintf(path,sizeof(path),"%s/octo-batch-%ld-%d",dirs[d],(long)getpid(),made++);
+    int fd=open(path,O_RDWR|O_CREAT|O_EXCL,0600);
+    if(fd<0)continue;
+    unlink(path);
+    char*image=calloc(1,b->stride);
+    memcpy(image,&b->model,sizeof(octo_emulator));
+    size_t n=0;
+    for(ssize_t w;n<b->stride&&(w=write(fd,image+n,b->stride-n))>0;)n+=w;
+    free(image);
+    if(n==b->stride)return fd;
+    close(fd);
+  }
+  return -1;
+}
+int octo_batch_map(octo_batch*b,int k){
+  // (re)place instance k with a private mapping of the model
+  return mmap(b->e+(size_t)k*b->stride,b->stride,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_FIXED,b->shared,0)!=MAP_FAILED;
+}
+#endif
+
+octo_batch* octo_batch_create(octo_emulator*model,int count,int threads){
+  octo_batch*b=calloc(1,sizeof(octo_batch));
+  memcpy(&b->model,model,sizeof(octo_emulator));
+  memset(b->model.pages,0,sizeof(b->model.pages));
+  b->count=count, b->shared=-1;
+  b->stride=(sizeof(octo_emulator)+OCTO_BATCH_ALIGN-1)/OCTO_BATCH_ALIGN*OCTO_BATCH_ALIGN;
+#ifdef OCTO_BATCH_SHARED
+  if((b->shared=octo_batch_image(b))>=0){
+    // reserve the address space, then map each instance into it
+    void*m=mmap(NULL,(size_t)count*b->stride,PROT_NONE,MAP_PRIVATE,b->shared,0);
+    b->e=m==MAP_FAILED?NULL:m;
+    for(int k=0;b->e&&k<count;k++)if(!octo_batch_map(b,k))munmap(b->e,(size_t)count*b->stride),b->e=NULL;
+    if(!b->e)close(b->shared),b->shared=-1;
+  }
+#endif
+  if(b->shared<0){
+    b->stride=sizeof(octo_emulator), b->e=malloc((size_t)count*b->stride);
+    for(int k=0;k<count;k++)memcpy(octo_batch_get(b,k),&b->model,sizeof(octo_emulator));
+  }
+  for(int k=0;k<count;k++)octo_batch_seed(b,k);
+#ifdef OCTO_BATCH_PTHREADS
+  b->threads=threads<1?1:threads;
+  b->pool=malloc(b->threads*sizeof(pthread_t));
+  pthread_mutex_init(&b->lock,NULL);
+  pthread_cond_init(&b->start,NULL);
+  pthread_cond_init(&b->done,NULL);
+  for(int t=1;t<b->threads;t++)pthread_create(b->pool+t,NULL,octo_batch_worker,b);
+#else
+  (void)threads;
+  b->threads=1;
+#endif
+  return b;
+}
+
+void octo_batch_run(octo_batch*b,int frames,octo_batch_input input,void*user){
+#ifdef OCTO_BATCH_PTHREADS
+  pthread_mutex_lock(&b->lock);
+#endif
+  b->frames=frames, b->input=input, b->user=user, b->next=0, b->busy=b->threads-1, b->generation++;
+#ifdef OCTO_BATCH_PTHREADS
+  pthread_cond_broadcast(&b->start);
+  pthread_mutex_unlock(&b->lock);
+#endif
+  octo_batch_work(b);
+#ifdef OCTO_BATCH_PTHREADS
+  pthread_mutex_lock(&b->lock);
+  while(b->busy>0)pthread_cond_wait(&b->done,&b->lock);
+  pthread_mutex_unlock(&b->lock);
+#endif
+  b->frame+=frames;
+}
+
+void octo_batch_reset(octo_batch*b){
+  for(int k=0;k<b->count;k++){
+#ifdef OCTO_BATCH_SHARED
+    if(b->shared>=0&&octo_batch_map(b,k)){octo_batch_seed(b,k);continue;}
+#endif
+    octo_emulator_reset(octo_batch_get(b,k),&b->model),octo_batch_seed(b,k);
+  }
+  if(b->cover)memset(b->cover,0,(size_t)b->count*OCTO_BATCH_COVER);
+  b->frame=0;
+}
+
+void octo_batch_cover(octo_batch*b){
+  if(!b->cover)b->cover=calloc(b->count,OCTO_BATCH_COVER);
+}
+
+void octo_batch_destroy(octo_batch*b){
+#ifdef OCTO_BATCH_PTHREADS
+  pthread_mutex_lock(&b->lock);
+  b->quit=1;
+  pthread_cond_broadcast(&b->start);
+  pthread_mutex_unlock(&b->lock);
+  for(int t=1;t<b->threads;t++)pthread_join(b->pool[t],NULL);
+  pthread_mutex_destroy(&b->lock);
+  pthread_cond_destroy(&b->start);
+  pthread_cond_destroy(&b->done);
+  free(b->pool);
+#endif
+  free(b->cover);
+#ifdef OCTO_BATCH_SHARED
+  if(b->shared>=0){munmap(b->e,(size_t)b->count*b->stride),close(b->shared),free(b);return;}
+#endif
+  free(b->e);
+  free(b);
+}
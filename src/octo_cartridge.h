@@ -11,7 +11,18 @@
 *  which saves a file, given source code and
 *  emulator options, and octo_cart_load(),
 *  which extracts source code and populates
-*  options from an existing file.
+*  options from an existing file. plain source
+*  files are loaded with octo_source_open().
+*
+*  a cart may also carry the rom its source
+*  compiles to, as hex in a "rom" field beside
+*  a "romHash" of the source. web-octo ignores
+*  both. octo_cart_load_rom() returns the rom
+*  only if the hash matches the source, so a
+*  cart edited elsewhere is compiled afresh.
+*  the hash covers only the cart's own text,
+*  so programs which :include other files
+*  should be saved without a rom.
 *
 **/
 
@@ -95,10 +106,25 @@ void octo_json_map_color(octo_str*s,char*key,int num){
 char* octo_touch_modes[]={"none","swipe","seg16","seg16fill","gamepad","vip"};
 char* octo_font_styles[]={"octo","vip","dream6800","eti660","schip","fish"};
 
-void octo_cart_format_json(octo_str*s,char*program,octo_options*o){
+uint32_t octo_cart_hash(char*program){
+  uint32_t h=2166136261u;
+  for(int z=0;program[z];z++)h=(h^(0xFF&program[z]))*16777619u;
+  return h;
+}
+
+void octo_cart_format_json(octo_str*s,char*program,octo_options*o,char*rom,int rom_size){
+  // the rom, if any, is rom_size bytes of the program as compiled from 0x200
   octo_str_append(s,'{');
   octo_json_map_str(s,"program",program);
   octo_str_append(s,',');
+  if(rom!=NULL){
+    char hash[9];
+    snprintf(hash,sizeof(hash),"%08X",octo_cart_hash(program));
+    octo_json_string(s,"rom"), octo_str_append(s,':'), octo_str_append(s,'"');
+    for(int z=0;z<rom_size;z++)octo_str_append(s,"0123456789ABCDEF"[(rom[z]>>4)&0xF]),octo_str_append(s,"0123456789ABCDEF"[rom[z]&0xF]);
+    octo_str_append(s,'"'), octo_str_append(s,',');
+    octo_json_map_str(s,"romHash",hash), octo_str_append(s,',');
+  }
   octo_json_string(s,"options");
   octo_str_append(s,':');
   octo_str_append(s,'{');
@@ -301,16 +327,28 @@ int octo_json_get_color(octo_str*s,octo_str*temp){
   return 0;
 }
 
-char* octo_cart_parse_json(octo_str*s,octo_options*o){
+char* octo_cart_parse_json(octo_str*s,octo_options*o,char**rom,int*rom_size){
+  // if rom is provided, it receives the compiled program only if it matches the source
   s->pos=0;
-  octo_str source, key, val;
-  octo_str_init(&source), octo_str_init(&key), octo_str_init(&val);
+  octo_str source, key, val, bytes;
+  octo_str_init(&source), octo_str_init(&key), octo_str_init(&val), octo_str_init(&bytes);
   source.root[0]='\0';
+  uint32_t hash=0; int has_hash=0, has_rom=0;
   if(octo_str_next(s)!='{')goto cleanup;
   while(octo_str_peek(s)=='"'){
     octo_json_get_str(s,&key);
     if(octo_str_next(s)!=':')break;
     if(strcmp(key.root,"program")==0){octo_json_get_str(s,&source);}
+    else if(strcmp(key.root,"romHash")==0){octo_json_get_str(s,&val);hash=strtoul(val.root,NULL,16),has_hash=1;}
+    else if(strcmp(key.root,"rom")==0){
+      octo_json_get_str(s,&val);
+      int n=strlen(val.root)/2; has_rom=n*2==(int)strlen(val.root)&&n<=OCTO_RAM_MAX-0x200;
+      for(int z=0;z<n&&has_rom;z++){
+        char hex[3]={val.root[2*z],val.root[2*z+1],'\0'};
+        has_rom=isxdigit(hex[0])&&isxdigit(hex[1]);
+        octo_str_append(&bytes,strtol(hex,NULL,16));
+      }
+    }
     else if(strcmp(key.root,"options")==0){
       if(octo_str_next(s)!='{')break;
       while(octo_str_peek(s)=='"'){
@@ -359,6 +397,8 @@ char* octo_cart_parse_json(octo_str*s,octo_options*o){
     if(octo_str_next(s)!=',')break;
   }
   cleanup:
+  if(rom&&has_rom&&has_hash&&hash==octo_cart_hash(source.root))*rom=bytes.root, *rom_size=bytes.pos;
+  else free(bytes.root);
   free(key.root),free(val.root);
   return source.root;
 }
@@ -608,6 +648,65 @@ char octo_cart_base_image[]={
 
 #include <sys/stat.h>
 
+/**
+*
+*  Source Files
+*
+*  source is mapped into memory where mmap() is available and
+*  read otherwise. the bytes are not NUL-terminated: compile
+*  them with octo_compile_buffer(), which does not keep them.
+*
+**/
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define OCTO_SOURCE_MMAP
+#endif
+
+typedef struct {
+  char*  data;
+  size_t size;
+  int    mapped;
+} octo_source;
+
+int octo_source_read(octo_source*s,FILE*f){
+  // read a stream such as a pipe to its end, a chunk at a time
+  size_t space=4096;
+  s->data=malloc(space), s->size=0, s->mapped=0;
+  while(1){
+    if(s->size==space)s->data=realloc(s->data,space*=2);
+    size_t n=fread(s->data+s->size,1,space-s->size,f);
+    if(n==0)break;
+    s->size+=n;
+  }
+  return !ferror(f);
+}
+int octo_source_open(octo_source*s,const char*filename){
+  struct stat st;
+  s->data=NULL, s->size=0, s->mapped=0;
+  if(stat(filename,&st)!=0)return 0;
+#ifdef OCTO_SOURCE_MMAP
+  int fd=open(filename,O_RDONLY);
+  if(fd<0)return 0;
+  void*m=st.st_size>0&&S_ISREG(st.st_mode)?mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0):MAP_FAILED;
+  close(fd);
+  if(m!=MAP_FAILED)return s->data=m, s->size=st.st_size, s->mapped=1, 1;
+#endif
+  FILE*f=fopen(filename,"rb");
+  if(f==NULL)return 0;
+  int ok=octo_source_read(s,f);
+  fclose(f);
+  return ok;
+}
+void octo_source_close(octo_source*s){
+#ifdef OCTO_SOURCE_MMAP
+  if(s->mapped){munmap(s->data,s->size);return;}
+#endif
+  free(s->data);
+}
+
 uint8_t octo_cart_byte(octo_gif*g,int*offset) {
   int size=g->width*g->height, i=(*offset)%size;
   octo_gif_frame*f=octo_list_get(&g->frames,(*offset)/size);
@@ -618,8 +717,10 @@ uint8_t octo_cart_byte(octo_gif*g,int*offset) {
   return (*offset)+=2, (a<<4)|b;
 }
 
-char* octo_cart_load(const char*filename,octo_options*o){
+char* octo_cart_load_rom(const char*filename,octo_options*o,char**rom,int*rom_size){
+  // as octo_cart_load(), also fetching the compiled program into rom if the cart has it, or NULL
   octo_str source;
+  if(rom)*rom=NULL, *rom_size=0;
   {
     struct stat st;
     if(stat(filename,&st)!=0)return NULL;
@@ -636,13 +737,16 @@ char* octo_cart_load(const char*filename,octo_options*o){
   for(int z=0;z<4;z++) size=(size<<8)|(0xFF&octo_cart_byte(g,&offset));
   for(int z=0;z<size;z++) octo_str_append(&json,octo_cart_byte(g,&offset));
   octo_str_append(&json,'\0');
-  char* program=octo_cart_parse_json(&json,o);
+  char* program=octo_cart_parse_json(&json,o,rom,rom_size);
   octo_str_destroy(&json);
   octo_gif_destroy(g);
   return program;
 }
+char* octo_cart_load(const char*filename,octo_options*o){
+  return octo_cart_load_rom(filename,o,NULL,NULL);
+}
 
-void octo_cart_save(FILE*dest,char*program,octo_options*o,char*label_pix,char*label_text){
+void octo_cart_save(FILE*dest,char*program,octo_options*o,char*label_pix,char*label_text,char*rom,int rom_size){
   octo_str base_data;
   base_data.pos=base_data.size=sizeof(octo_cart_base_image);
   base_data.root=octo_cart_base_image;
@@ -683,7 +787,7 @@ void octo_cart_save(FILE*dest,char*program,octo_options*o,char*label_pix,char*la
   octo_str json;
   octo_str_init(&json);
   json.pos+=4; // reserve space for size bytes
-  octo_cart_format_json(&json,program,o);
+  octo_cart_format_json(&json,program,o,rom,rom_size);
   json.pos-=1; // don't write out the null terminator!
   json.root[0]=((json.pos-4)>>24)&0xFF;
   json.root[1]=((json.pos-4)>>16)&0xFF;
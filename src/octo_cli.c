@@ -3,13 +3,23 @@
 *  Octo CLI
 *
 *  A simple command-line frontend for the c-octo
-*  compiler and related tools.
+*  compiler and related tools, including a decoder
+*  for the instruction traces written by octo-run
+*  and a watch mode which rebuilds on every save.
 *
 **/
 
 #include "octo_compiler.h"
 #include "octo_emulator.h"
 #include "octo_cartridge.h"
+#include "octo_profile.h"
+#include "octo_trace.h"
+#include "octo_optimizer.h"
+#include "octo_reload.h"
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
 
 char* escape(char*dest,char*src){
   int n=strlen(src), e=0;
@@ -17,28 +27,65 @@ char* escape(char*dest,char*src){
   if(!e){snprintf(dest,4096,"%s",src);return dest;}
   int d=0;dest[d++]='"';
   for(int z=0;z<n&&d+3<4096;z++){if(src[z]=='"'){dest[d++]='"';}dest[d++]=src[z];}
-  dest[d++]='"';return dest;
+  dest[d++]='"',dest[d]='\0';return dest;
 }
 
-void compile(char*source,FILE*dest_file,FILE*sym_file){
-  octo_program*p=octo_compile_str(source);
+void optimize(octo_program*p,int passes,octo_opt_stats*s){
+  octo_optimize(p,s,passes);
+  if(passes&OCTO_PASS_PEEPHOLE){
+    fprintf(stderr,"optimized: %d bytes saved. %d tail calls, %d jumps threaded, %d jumps to a return, %d reloads of i, %d dead stores.\n",
+      s->bytes-s->packed-s->pruned,s->tails,s->threaded,s->returns,s->loads,s->stores);
+    if(s->held)fprintf(stderr,"  %d bytes of dead code kept, as the program uses numeric or calculated addresses.\n",s->held);
+  }
+  char*pinned="nothing, as the program uses numeric or calculated addresses";
+  if(passes&OCTO_PASS_PRUNE){
+    if(p->pinned)fprintf(stderr,"pruned: %s.\n",pinned);
+    else         fprintf(stderr,"pruned: %d bytes of unreachable code and data removed.\n",s->pruned);
+  }
+  if(passes&OCTO_PASS_PACK){
+    if(p->pinned)fprintf(stderr,"packed: %s.\n",pinned);
+    else         fprintf(stderr,"packed: %d bytes of data saved.\n",s->packed);
+  }
+}
+
+void report(octo_program*p){
+  // time spent on each file, the source first and then its includes
+  for(int z=0;z<p->files.count;z++){
+    octo_file*f=octo_list_get(&p->files,z);
+    if(z==0)fprintf(stderr,"compiled %s in %.3fms.\n",f->path?f->path:"<stdin>",f->seconds*1000);
+    else    fprintf(stderr,"  included %s in %.3fms. (%d tokens%s)\n",f->path,f->seconds*1000,f->tokens,f->cached?", cached":"");
+  }
+}
+
+void compile(octo_source*source,char*path,FILE*dest_file,FILE*sym_file,int passes,int verbose,char*rom,int rom_size){
+  if(rom&&!sym_file&&!passes&&!verbose){fwrite(rom,sizeof(char),rom_size,dest_file);return;} // as compiled into the cart
+  octo_program*p=octo_program_path(octo_program_init_buffer(source->data,source->size,0),path);
+  p->timed=verbose;
+  octo_compile_program(p);
   if(p->is_error){
+    if(octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
     fprintf(stderr,"(%d:%d) %s\n",p->error_line+1,p->error_pos+1,p->error);
     exit(1);
   }
+  if(verbose)report(p);
+  octo_opt_stats s={0};
+  if(passes)optimize(p,passes,&s);
   fwrite(p->rom+0x200,sizeof(char),p->length-0x200,dest_file);
-  if(!sym_file)return;
+  if(!sym_file){free(s.saved),free(s.unused);return;}
   fprintf(sym_file,"type,name,value\n");
   char ek[4096], ev[4096];
-  for(int z=0;z<OCTO_RAM_MAX;z++){
-    if(!p->breakpoints[z])continue;
-    fprintf(sym_file,"breakpoint,%s,%d\n",escape(ek,p->breakpoints[z]),z);
+  for(int z=0;z<p->breaks.count;z++){
+    octo_break*b=octo_list_get(&p->breaks,z);
+    fprintf(sym_file,"breakpoint,%s,%d\n",escape(ek,b->message),b->addr);
   }
   for(int z=0;z<p->constants.keys.count;z++){
     char*k=octo_list_get(&p->constants.keys,z);if(!strncmp("OCTO_",k,5))continue;
     octo_const*c=octo_list_get(&p->constants.values,z);
+    if(s.unused&&s.unused[z]){fprintf(sym_file,"removed,%s,%d\n",escape(ek,k),s.unused[z]);continue;}
     fprintf(sym_file,"constant,%s,%d\n",escape(ek,k),(int)c->value);
+    if(s.saved&&s.saved[z])fprintf(sym_file,"packed,%s,%d\n",ek,s.saved[z]);
   }
+  free(s.saved),free(s.unused);
   for(int z=0;z<p->aliases.keys.count;z++){
     char*k=octo_list_get(&p->aliases.keys,z);
     octo_reg*r=octo_list_get(&p->aliases.values,z);
@@ -52,44 +99,188 @@ void compile(char*source,FILE*dest_file,FILE*sym_file){
   fclose(sym_file);
 }
 
+int decode(char*trace_filename,char*source_filename){
+  // print a trace, naming addresses after the labels of its source, if provided
+  octo_trace_file t;
+  if(!octo_trace_load(&t,trace_filename))return 1;
+  octo_program*p=NULL;
+  if(source_filename!=NULL){
+    octo_source source;
+    if(!octo_source_open(&source,source_filename)){fprintf(stderr,"%s: No such file or directory\n",source_filename);return 1;}
+    p=octo_compile_program(octo_program_path(octo_program_init_buffer(source.data,source.size,0),source_filename));
+    octo_source_close(&source);
+    if(p->is_error&&octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
+    if(p->is_error){fprintf(stderr,"(%d:%d) %s\n",p->error_line+1,p->error_pos+1,p->error);return 1;}
+  }
+  char**labels=p?octo_profile_labels(p):NULL;
+  octo_trace_write(&t,labels,stdout);
+  free(labels);
+  free(t.entries);
+  return 0;
+}
+
+/**
+*
+*  Watch Mode
+*
+*  rebuild the source whenever it or any file it includes is
+*  saved, and hand each good build to octo-run -r. the include
+*  cache lives as long as the process, so an unchanged include
+*  is not tokenized again.
+*
+**/
+
+int build(char*path,char*dest_filename,int passes,int verbose,octo_list*files){
+  // compile once, noting every file the build read (or tried to) in files
+  octo_source source;
+  if(!octo_source_open(&source,path)){fprintf(stderr,"%s: No such file or directory\n",path);return 0;}
+  octo_program*p=octo_program_path(octo_program_init_buffer(source.data,source.size,0),path);
+  p->timed=1;
+  octo_compile_program(p);
+  octo_source_close(&source);
+  double seconds=0;
+  for(int z=0;z<p->files.count;z++){
+    octo_file*f=octo_list_get(&p->files,z);
+    if(z>0)octo_list_append(files,strcpy(malloc(strlen(f->path)+1),f->path));
+    seconds+=f->seconds;
+  }
+  if(p->is_error){
+    if(octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
+    fprintf(stderr,"(%d:%d) %s\n",p->error_line+1,p->error_pos+1,p->error);
+    octo_free_program(p);
+    return 0;
+  }
+  if(verbose)report(p);
+  octo_opt_stats s={0};
+  if(passes)optimize(p,passes,&s);
+  free(s.saved),free(s.unused);
+  FILE*dest_file=dest_filename?fopen(dest_filename,"wb"):NULL;
+  if(dest_file)fwrite(p->rom+0x200,sizeof(char),p->length-0x200,dest_file),fclose(dest_file);
+  else if(dest_filename)fprintf(stderr,"%s: Unable to open file for writing\n",dest_filename);
+  int sent=octo_reload_send((char*)p->rom+0x200,p->length-0x200);
+  fprintf(stderr,"built %s: %d bytes in %.3fms%s.\n",path,p->length-0x200,seconds*1000,sent>0?", sent to octo-run":"");
+  octo_free_program(p);
+  return 1;
+}
+
+#ifdef __linux__
+int watch(int fd,char*path){
+  // the inotify descriptor of the directory holding path
+  char*slash=strrchr(path,'/');
+  if(!slash)return inotify_add_watch(fd,".",IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE);
+  char dir[4096];
+  snprintf(dir,sizeof(dir),"%.*s",slash==path?1:(int)(slash-path),path);
+  return inotify_add_watch(fd,dir,IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE);
+}
+
+int watch_loop(char*path,char*dest_filename,int passes,int verbose){
+  int fd=inotify_init();
+  if(fd<0){fprintf(stderr,"unable to watch for changes.\n");return 1;}
+  octo_list files;
+  octo_list_init(&files);
+  while(1){
+    octo_list_destroy(&files,free);
+    octo_list_init(&files);
+    octo_list_append(&files,strcpy(malloc(strlen(path)+1),path));
+    build(path,dest_filename,passes,verbose,&files);
+    int*wd=malloc(files.count*sizeof(int));
+    for(int z=0;z<files.count;z++)wd[z]=watch(fd,octo_list_get(&files,z));
+
+    // wait for a save, then let a burst of events settle before rebuilding
+    int changed=0;
+    for(int timeout=-1;;timeout=50){
+      struct pollfd w={fd,POLLIN,0};
+      if(poll(&w,1,timeout)<=0){if(changed)break;continue;}
+      char buffer[8192];
+      int n=read(fd,buffer,sizeof(buffer));
+      for(int at=0;at+(int)sizeof(struct inotify_event)<=n;){
+        struct inotify_event e;
+        memcpy(&e,buffer+at,sizeof(e));
+        char*name=buffer+at+sizeof(e);
+        at+=sizeof(e)+e.len;
+        if(e.len==0)continue;
+        for(int z=0;z<files.count;z++){
+          char*f=octo_list_get(&files,z), *base=strrchr(f,'/');
+          if(wd[z]!=e.wd||strcmp(base?base+1:f,name))continue;
+          changed=1;
+          // saves within a second of each other may share an mtime, so check the text
+          for(int c=0;c<octo_include_cache.count;c++){
+            octo_included*i=octo_list_get(&octo_include_cache,c);
+            if(!strcmp(i->path,f))i->mtime=0;
+          }
+        }
+      }
+    }
+    free(wd);
+  }
+}
+#else
+int watch_loop(char*path,char*dest_filename,int passes,int verbose){
+  (void)path, (void)dest_filename, (void)passes, (void)verbose;
+  fprintf(stderr,"watching for changes is not supported on this platform.\n");
+  return 1;
+}
+#endif
+
 int main(int argc,char** argv) {
   if(argc<2){
     printf("octo-cli v%s\n",VERSION);
-    printf("usage: %s <source> [<destination>] [-s <symfile>]\n",argv[0]);
+    printf("usage: %s <source> [<destination>] [-s <symfile>] [-O] [-P] [-D] [-v]\n",argv[0]);
+    printf("       (a <source> of - reads from standard input)\n");
+    printf("       %s -w <source> [<destination>] [-O] [-P] [-D] [-v]\n",argv[0]);
+    printf("       (rebuilds on every save, sending each build to octo-run -r)\n");
+    printf("       %s -t <trace> [<source>]\n",argv[0]);
     return 0;
   }
 
   char*source_filename=NULL;
   char*dest_filename=NULL;
   char*sym_filename=NULL;
+  char*trace_filename=NULL;
+  int passes=0, verbose=0, watching=0;
   for(int z=1;z<argc;z++){
     if(!strcmp(argv[z],"-s")){
       if(z+1>=argc){fprintf(stderr,"no symbol file path specified for -s.\n");return 1;}
       sym_filename=argv[++z];
     }
-    if(source_filename==NULL){source_filename=argv[z];}
+    else if(!strcmp(argv[z],"-t")){
+      if(z+1>=argc){fprintf(stderr,"no trace file path specified for -t.\n");return 1;}
+      trace_filename=argv[++z];
+    }
+    else if(!strcmp(argv[z],"-O")){passes|=OCTO_PASS_PEEPHOLE;}
+    else if(!strcmp(argv[z],"-P")){passes|=OCTO_PASS_PACK;}
+    else if(!strcmp(argv[z],"-D")){passes|=OCTO_PASS_PRUNE;}
+    else if(!strcmp(argv[z],"-v")){verbose=1;}
+    else if(!strcmp(argv[z],"-w")||!strcmp(argv[z],"--watch")){watching=1;}
+    else if(source_filename==NULL){source_filename=argv[z];}
     else{dest_filename=argv[z];}
   }
+  if(trace_filename!=NULL)return decode(trace_filename,source_filename);
+  if(source_filename==NULL){fprintf(stderr,"no source file specified.\n");return 1;}
+  if(watching){
+    if(!strcmp("-",source_filename)||!strcmp(".gif",source_filename+(strlen(source_filename)-4))){fprintf(stderr,"only .8o sources can be watched.\n");return 1;}
+    return watch_loop(source_filename,dest_filename,passes,verbose);
+  }
 
-  // read input { .8o, .gif }
+  // read input { .8o, .gif, - }
   octo_options o;
   octo_default_options(&o);
-  char*source=NULL;
+  octo_source source;
+  char*rom=NULL; int rom_size=0;
   if(strcmp(".gif",source_filename+(strlen(source_filename)-4))==0){
-    source=octo_cart_load(argv[1],&o);
-    if(source==NULL){fprintf(stderr,"%s: Unable to load octocart\n",source_filename);return 1;}
+    source.data=octo_cart_load_rom(source_filename,&o,&rom,&rom_size), source.mapped=0;
+    if(source.data==NULL){fprintf(stderr,"%s: Unable to load octocart\n",source_filename);return 1;}
+    source.size=strlen(source.data);
+  }
+  else if(strcmp("-",source_filename)==0){
+    if(!octo_source_read(&source,stdin)){fprintf(stderr,"Unable to read standard input\n");return 1;}
   }
-  else {
-    struct stat st;
-    if(stat(source_filename,&st)!=0){fprintf(stderr,"%s: No such file or directory\n",source_filename);return 1;}
-    size_t source_size=st.st_size;
-    source=malloc(source_size+1);
-    FILE*source_file=fopen(source_filename,"rb");
-    fread(source,sizeof(char),source_size,source_file);
-    source[source_size]='\0';
-    fclose(source_file);
+  else if(!octo_source_open(&source,source_filename)){
+    fprintf(stderr,"%s: No such file or directory\n",source_filename);return 1;
   }
 
+  char*path=strcmp("-",source_filename)?source_filename:NULL; // includes are found beside the source
+
   // write output { .ch8, .8o, .gif }
   FILE*sym_file=NULL;
   if(sym_filename!=NULL){
@@ -97,11 +288,22 @@ int main(int argc,char** argv) {
     if(sym_file==NULL){fprintf(stderr,"%s: Unable to open symbol file for writing\n",sym_filename);return 1;}
   }
 
-  if(dest_filename==NULL){compile(source,stdout,sym_file);return 0;}
+  if(dest_filename==NULL){compile(&source,path,stdout,sym_file,passes,verbose,rom,rom_size);return 0;}
   FILE*dest_file=fopen(dest_filename,"wb");
   if(dest_file==NULL){fprintf(stderr,"%s: Unable to open file for writing\n",dest_filename);return 1;}
-  if     (strcmp(".gif",dest_filename+(strlen(dest_filename)-4))==0){octo_cart_save(dest_file,source,&o,NULL,dest_filename);}
-  else if(strcmp(".8o", dest_filename+(strlen(dest_filename)-3))==0){fwrite(source,sizeof(char),strlen(source),dest_file);}
-  else                                                              {compile(source,dest_file,sym_file);}
+  if(strcmp(".gif",dest_filename+(strlen(dest_filename)-4))==0){
+    char*text=memcpy(malloc(source.size+1),source.data,source.size);
+    text[source.size]='\0';
+    // the cart carries the rom as well, if the program compiles. the hash can't cover includes, so not then.
+    octo_program*p=octo_compile_program(octo_program_path(octo_program_init_buffer(source.data,source.size,0),path));
+    if(p->is_error||p->files.count>1)octo_cart_save(dest_file,text,&o,NULL,dest_filename,NULL,0);
+    else           octo_cart_save(dest_file,text,&o,NULL,dest_filename,(char*)p->rom+0x200,p->length-0x200);
+    octo_free_program(p);
+    free(text);
+  }
+  else if(strcmp(".8o", dest_filename+(strlen(dest_filename)-3))==0){fwrite(source.data,sizeof(char),source.size,dest_file);}
+  else                                                              {compile(&source,path,dest_file,sym_file,passes,verbose,rom,rom_size);}
   fclose(dest_file);
+  octo_source_close(&source);
+  free(rom);
 }
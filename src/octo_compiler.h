@@ -6,12 +6,18 @@
 *  suitable for embedding in other tools and environments.
 *  depends only upon the C standard library.
 *
-*  the public interface is octo_compile_str(char*);
+*  the public interface is octo_compile_str(char*),
+*  or octo_compile_buffer(char*,size_t,int) for source
+*  which is not NUL-terminated, such as a mapped file;
 *  the result will contain a 64k ROM image in the
 *  'rom' field of the returned octo_program.
 *  octo_free_program can clean up the entire structure
 *  when a consumer is finished using it.
 *
+*  apart from the C standard library, it depends only
+*  upon stat(), which :include uses to notice changes
+*  to the files it caches.
+*
 **/
 
 #include <stdio.h>
@@ -19,6 +25,12 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// bump whenever the rom, symbols or debug data compiled from the same
+// source change, so that programs cached by an older build are not reused.
+#define OCTO_COMPILER_REVISION 1
 
 /**
 *
@@ -47,7 +59,7 @@ void octo_list_destroy(octo_list* list,void items(void*)) {
 }
 void octo_list_grow(octo_list* list) {
   if(list->count<list->space)return;
-  list->data=realloc(list->data,(sizeof(void*))*(list->space+=OCTO_LIST_BLOCK_SIZE));
+  list->data=realloc(list->data,(sizeof(void*))*(list->space*=2));
 }
 void octo_list_append(octo_list* list, void* item) {
   octo_list_grow(list);
@@ -127,6 +139,57 @@ void* octo_map_set(octo_map* map, char* key, void* value){
 *
 **/
 
+// every word the compiler matches on, with whether it is reserved
+// (and so may not name a constant, label, alias or macro) and whether
+// it begins a statement. interned first by every program, so that each
+// token carries its keyword id and the compiler can dispatch on it.
+#define OCTO_KEYWORDS(k) \
+  k(ASSIGN      ,":="          ,1,0) k(OR_ASSIGN   ,"|="          ,1,0) k(AND_ASSIGN  ,"&="          ,1,0) \
+  k(XOR_ASSIGN  ,"^="          ,1,0) k(SUB_ASSIGN  ,"-="          ,1,0) k(RSUB_ASSIGN ,"=-"          ,1,0) \
+  k(ADD_ASSIGN  ,"+="          ,1,0) k(SHR_ASSIGN  ,">>="         ,1,0) k(SHL_ASSIGN  ,"<<="         ,1,0) \
+  k(EQ          ,"=="          ,1,0) k(NE          ,"!="          ,1,0) k(LT          ,"<"           ,1,0) \
+  k(GT          ,">"           ,1,0) k(LE          ,"<="          ,1,0) k(GE          ,">="          ,1,0) \
+  k(KEY         ,"key"         ,1,0) k(NKEY        ,"-key"        ,1,0) k(HEX         ,"hex"         ,1,0) \
+  k(BIGHEX      ,"bighex"      ,1,0) k(RANDOM      ,"random"      ,1,0) k(DELAY       ,"delay"       ,1,1) \
+  k(LABEL       ,":"           ,1,1) k(NEXT        ,":next"       ,1,1) k(UNPACK      ,":unpack"     ,1,1) \
+  k(BREAKPOINT  ,":breakpoint" ,1,1) k(PROTO       ,":proto"      ,1,1) k(ALIAS       ,":alias"      ,1,1) \
+  k(CONST       ,":const"      ,1,1) k(ORG         ,":org"        ,1,1) k(SEMI        ,";"           ,1,1) \
+  k(RETURN      ,"return"      ,1,1) k(CLEAR       ,"clear"       ,1,1) k(BCD         ,"bcd"         ,1,1) \
+  k(SAVE        ,"save"        ,1,1) k(LOAD        ,"load"        ,1,1) k(BUZZER      ,"buzzer"      ,1,1) \
+  k(IF          ,"if"          ,1,1) k(THEN        ,"then"        ,1,0) k(BEGIN       ,"begin"       ,1,0) \
+  k(ELSE        ,"else"        ,1,1) k(END         ,"end"         ,1,1) k(JUMP        ,"jump"        ,1,1) \
+  k(JUMP0       ,"jump0"       ,1,1) k(NATIVE      ,"native"      ,1,1) k(SPRITE      ,"sprite"      ,1,1) \
+  k(LOOP        ,"loop"        ,1,1) k(WHILE       ,"while"       ,1,1) k(AGAIN       ,"again"       ,1,1) \
+  k(SCROLL_DOWN ,"scroll-down" ,1,1) k(SCROLL_UP   ,"scroll-up"   ,1,1) k(SCROLL_RIGHT,"scroll-right",1,1) \
+  k(SCROLL_LEFT ,"scroll-left" ,1,1) k(LORES       ,"lores"       ,1,1) k(HIRES       ,"hires"       ,1,1) \
+  k(LOADFLAGS   ,"loadflags"   ,1,1) k(SAVEFLAGS   ,"saveflags"   ,1,1) k(I           ,"i"           ,1,1) \
+  k(AUDIO       ,"audio"       ,1,1) k(PLANE       ,"plane"       ,1,1) k(MACRO       ,":macro"      ,1,1) \
+  k(CALC        ,":calc"       ,1,1) k(BYTE        ,":byte"       ,1,1) k(CALL        ,":call"       ,1,1) \
+  k(STRINGMODE  ,":stringmode" ,1,1) k(ASSERT      ,":assert"     ,1,1) k(MONITOR     ,":monitor"    ,1,1) \
+  k(POINTER     ,":pointer"    ,1,1) k(PITCH       ,"pitch"       ,1,1) k(WATCH       ,":watch"      ,1,1) \
+  k(WATCH_READ  ,":watch-read" ,1,1) k(EXIT        ,"exit"        ,0,1) k(LONG        ,"long"        ,0,0) \
+  k(LBRACE      ,"{"           ,0,0) k(RBRACE      ,"}"           ,0,0) k(LPAREN      ,"("           ,0,0) \
+  k(RPAREN      ,")"           ,0,0) k(MINUS       ,"-"           ,0,0) k(PLUS        ,"+"           ,0,0) \
+  k(TIMES       ,"*"           ,0,0) k(DIVIDE      ,"/"           ,0,0) k(MOD         ,"%"           ,0,0) \
+  k(BITAND      ,"&"           ,0,0) k(BITOR       ,"|"           ,0,0) k(BITXOR      ,"^"           ,0,0) \
+  k(BITNOT      ,"~"           ,0,0) k(NOT         ,"!"           ,0,0) k(SHL         ,"<<"          ,0,0) \
+  k(SHR         ,">>"          ,0,0) k(PEEK        ,"@"           ,0,0) k(STRLEN      ,"strlen"      ,0,0) \
+  k(SIN         ,"sin"         ,0,0) k(COS         ,"cos"         ,0,0) k(TAN         ,"tan"         ,0,0) \
+  k(EXP         ,"exp"         ,0,0) k(LOG         ,"log"         ,0,0) k(ABS         ,"abs"         ,0,0) \
+  k(SQRT        ,"sqrt"        ,0,0) k(SIGN        ,"sign"        ,0,0) k(CEIL        ,"ceil"        ,0,0) \
+  k(FLOOR       ,"floor"       ,0,0) k(POW         ,"pow"         ,0,0) k(MIN         ,"min"         ,0,0) \
+  k(MAX         ,"max"         ,0,0) k(PI          ,"PI"          ,0,0) k(E           ,"E"           ,0,0) \
+  k(HERE        ,"HERE"        ,0,0) k(INCLUDE     ,":include"    ,1,1)
+
+#define OCTO_KW_ID(id,name,reserved,statement) OCTO_KW_##id,
+enum {OCTO_KW_NONE, OCTO_KEYWORDS(OCTO_KW_ID) OCTO_KW_COUNT};
+#undef OCTO_KW_ID
+
+typedef struct { char* name; char reserved, statement; } octo_keyword;
+#define OCTO_KW_ROW(id,name,reserved,statement) {name,reserved,statement},
+octo_keyword octo_keywords[]={{"",0,0}, OCTO_KEYWORDS(OCTO_KW_ROW)};
+#undef OCTO_KW_ROW
+
 #define OCTO_TOK_STR 0
 #define OCTO_TOK_NUM 1
 #define OCTO_TOK_EOF 2
@@ -134,6 +197,9 @@ typedef struct {
   int type;
   int line;
   int pos;
+  int file; // the index of the file this came from, in octo_program.files
+  int kw;   // OCTO_KW_NONE unless a string matching a keyword
+  int slot; // in a macro body, the binding which replaces this token, or -1
   union {
     char*  str_value;
     double num_value;
@@ -142,11 +208,10 @@ typedef struct {
 
 octo_tok* octo_make_tok_null(int line,int pos){
   octo_tok*r=malloc(sizeof(octo_tok));
-  return r->type=OCTO_TOK_EOF, r->line=line, r->pos=pos, r->str_value="", r;
+  return r->type=OCTO_TOK_EOF, r->file=0, r->line=line, r->pos=pos, r->kw=0, r->slot=-1, r->str_value="", r;
 }
-octo_tok* octo_make_tok_num(int n){
-  octo_tok*r=malloc(sizeof(octo_tok));
-  return r->type=OCTO_TOK_NUM, r->line=0, r->pos=0, r->num_value=n, r;
+octo_tok* octo_init_tok_num(octo_tok*r,int n){
+  return r->type=OCTO_TOK_NUM, r->file=0, r->line=0, r->pos=0, r->kw=0, r->slot=-1, r->num_value=n, r;
 }
 octo_tok* octo_tok_copy(octo_tok*x){
   octo_tok*r=malloc(sizeof(octo_tok));
@@ -162,23 +227,29 @@ char* octo_tok_value(octo_tok*t,char*d){
   return d;
 }
 
-typedef struct { double value; char is_mutable;                       } octo_const;
+typedef struct { double value; char is_mutable, is_label;             } octo_const;
 typedef struct { int    value;                                        } octo_reg;
 typedef struct { int    value; char is_long;                          } octo_pref;
-typedef struct { int line,pos; octo_list addrs;                       } octo_proto;
+typedef struct { int file,line,pos; octo_list addrs;                  } octo_proto;
 typedef struct { int calls; octo_list args,body;                      } octo_macro;
 typedef struct { int calls; char values[256]; octo_macro* modes[256]; } octo_smode;
-typedef struct { int addr,line,pos; char* type;                       } octo_flow;
+typedef struct { int addr,file,line,pos; char* type;                  } octo_flow;
 typedef struct { int type,base,len; char* format;                     } octo_mon;
+typedef struct { int base,len,read;                                   } octo_watch;
+typedef struct { int addr; char* message;                             } octo_break;
+typedef struct { double value; int index; char* name;                 } octo_label;
+typedef struct { char* path; int tokens, parent; char cached; double seconds; } octo_file;
 
 octo_const* octo_make_const(double v,char m){octo_const*r=calloc(1,sizeof(octo_const));r->value=v,r->is_mutable=m;                       return r;}
 octo_reg  * octo_make_reg  (int v)          {octo_reg  *r=calloc(1,sizeof(octo_reg  ));r->value=v;                                       return r;}
 octo_pref * octo_make_pref (int a,char l)   {octo_pref *r=calloc(1,sizeof(octo_pref ));r->value=a;r->is_long=l;                          return r;}
-octo_proto* octo_make_proto(int l,int p)    {octo_proto*r=calloc(1,sizeof(octo_proto));octo_list_init(&r->addrs);r->line=l,r->pos=p;     return r;}
+octo_proto* octo_make_proto(int f,int l,int p){octo_proto*r=calloc(1,sizeof(octo_proto));octo_list_init(&r->addrs);r->file=f,r->line=l,r->pos=p;return r;}
 octo_macro* octo_make_macro(void)           {octo_macro*r=calloc(1,sizeof(octo_macro));octo_list_init(&r->args),octo_list_init(&r->body);return r;}
 octo_smode* octo_make_smode(void)           {octo_smode*r=calloc(1,sizeof(octo_smode));                                                  return r;}
-octo_flow * octo_make_flow (int a,int l,int p,char*t){octo_flow*r=calloc(1,sizeof(octo_flow));r->addr=a,r->line=l,r->pos=p,r->type=t;    return r;}
+octo_flow * octo_make_flow (int a,int f,int l,int p,char*t){octo_flow*r=calloc(1,sizeof(octo_flow));r->addr=a,r->file=f,r->line=l,r->pos=p,r->type=t;return r;}
 octo_mon  * octo_make_mon  (void)           {octo_mon  *r=calloc(1,sizeof(octo_mon  ));                                                  return r;}
+octo_break* octo_make_break(int a,char*m) {octo_break*r=calloc(1,sizeof(octo_break));r->addr=a,r->message=m;                          return r;}
+octo_watch* octo_make_watch(int b,int l,int rd){octo_watch*r=calloc(1,sizeof(octo_watch));r->base=b,r->len=l,r->read=rd;                 return r;}
 
 void octo_free_tok  (octo_tok  *x) {free(x);}
 void octo_free_const(octo_const*x) {free(x);}
@@ -189,6 +260,16 @@ void octo_free_macro(octo_macro*x) {octo_list_destroy(&x->args,NULL);octo_list_d
 void octo_free_smode(octo_smode*x) {for(int z=0;z<256;z++)if(x->modes[z])octo_free_macro(x->modes[z]);free(x);}
 void octo_free_flow (octo_flow *x) {free(x);}
 void octo_free_mon  (octo_mon  *x) {free(x);}
+void octo_free_watch(octo_watch*x) {free(x);}
+void octo_free_break(octo_break*x) {free(x);}
+void octo_free_file (octo_file *x) {free(x->path);free(x);}
+
+// flags kept in octo_program.code for each address of the rom
+#define OCTO_CODE_OP    0x01 // an instruction begins here
+#define OCTO_CODE_ADDR  0x02 // the instruction or data here holds the address of a label
+#define OCTO_CODE_LONG  0x04 // ...in 16 bits, rather than the low 12
+#define OCTO_CODE_FIXED 0x08 // this address is given as a number or calculated
+#define OCTO_CODE_ORG   0x10 // an :org begins here
 
 typedef struct {
   // string interning table
@@ -198,9 +279,12 @@ typedef struct {
   // tokenizer
   char*     source;
   char*     source_root;
+  char*     source_end;
+  char      source_owned;  // free source_root with the program?
   int       source_line;
   int       source_pos;
-  octo_list tokens;
+  int       source_file;   // the index in files of the text being tokenized
+  octo_list tokens;      // lookahead, in reverse: the next token is last
 
   // compiler
   char       has_main;    // do we need a trampoline for 'main'?
@@ -208,6 +292,9 @@ typedef struct {
   int        length;
   char       rom [OCTO_RAM_MAX];
   char       used[OCTO_RAM_MAX];
+  char       code[OCTO_RAM_MAX]; // OCTO_CODE_ flags, for optimizers
+  char       pinned;      // must the rom stay where it is? (is any address fixed?)
+  char       calc_label;  // did the last calculation read an address?
   octo_map   constants;   // name -> octo_const
   octo_map   aliases;     // name -> octo_reg
   octo_map   protos;      // name -> octo_proto
@@ -218,18 +305,28 @@ typedef struct {
   octo_stack whiles;      // [octo_flow], value=-1 indicates a marker
 
   // debugging
-  char*      breakpoints[OCTO_RAM_MAX];
+  unsigned char breakpoints[OCTO_RAM_MAX/8]; // addresses with a breakpoint (bitmask)
+  octo_list  breaks;   // [octo_break], sorted by address
+  octo_label*labels;   // every constant, sorted by value and then definition order
+  int        label_count;
+  char*      register_aliases[16]; // the aliases of each register, comma-separated, or NULL
   octo_map   monitors; // name -> octo_mon
+  octo_list  watches;  // [octo_watch]
+
+  // source files
+  octo_list  files;    // [octo_file], the source itself and then each :include in turn
+  char       timed;    // measure the time spent compiling each file?
 
   // error reporting
   char       is_error;
   char       error[OCTO_ERR_MAX];
   int        error_line;
   int        error_pos;
+  int        error_file; // the index in files of the error, 0 for the source itself
 } octo_program;
 
 void octo_free_program(octo_program*p){
-  free(p->source_root);
+  if(p->source_owned)free(p->source_root);
   octo_list_destroy (&p->tokens     ,OCTO_DESTRUCTOR(octo_free_tok  ));
   octo_map_destroy  (&p->constants  ,OCTO_DESTRUCTOR(octo_free_const));
   octo_map_destroy  (&p->aliases    ,OCTO_DESTRUCTOR(octo_free_reg  ));
@@ -240,9 +337,90 @@ void octo_free_program(octo_program*p){
   octo_stack_destroy(&p->branches   ,OCTO_DESTRUCTOR(octo_free_flow ));
   octo_stack_destroy(&p->whiles     ,OCTO_DESTRUCTOR(octo_free_flow ));
   octo_map_destroy  (&p->monitors   ,OCTO_DESTRUCTOR(octo_free_mon  ));
+  octo_list_destroy (&p->watches    ,OCTO_DESTRUCTOR(octo_free_watch));
+  octo_list_destroy (&p->breaks     ,OCTO_DESTRUCTOR(octo_free_break));
+  octo_list_destroy (&p->files      ,OCTO_DESTRUCTOR(octo_free_file ));
+  free(p->labels);
+  for(int z=0;z<16;z++)free(p->register_aliases[z]);
   free(p);
 }
 
+/**
+*
+*  Breakpoints
+*
+*  a bitmap answers whether an address has a breakpoint,
+*  which debuggers test after every instruction, and the
+*  messages live in a table sorted by address.
+*
+**/
+
+int octo_break_index(octo_program*p,int addr){
+  // the position of the first breakpoint at or after addr
+  int lo=0, hi=p->breaks.count;
+  while(lo<hi){int m=(lo+hi)/2; if(((octo_break*)octo_list_get(&p->breaks,m))->addr<addr)lo=m+1; else hi=m;}
+  return lo;
+}
+void octo_set_breakpoint(octo_program*p,int addr,char*message){
+  addr&=OCTO_RAM_MAX-1;
+  int z=octo_break_index(p,addr);
+  octo_break*b=z<p->breaks.count?octo_list_get(&p->breaks,z):NULL;
+  if(b!=NULL&&b->addr==addr)b->message=message;
+  else octo_list_insert(&p->breaks,octo_make_break(addr,message),z);
+  p->breakpoints[addr>>3]|=1<<(addr&7);
+}
+char* octo_breakpoint(octo_program*p,int addr){
+  // the message of the breakpoint at addr, or NULL
+  addr&=OCTO_RAM_MAX-1;
+  if(!((p->breakpoints[addr>>3]>>(addr&7))&1))return NULL;
+  return ((octo_break*)octo_list_get(&p->breaks,octo_break_index(p,addr)))->message;
+}
+
+/**
+*
+*  Symbol Index
+*
+*  built once a program compiles, so debuggers can name an
+*  address or a register without scanning every constant.
+*  an address is named after the first constant defined
+*  with the greatest value at or below it.
+*
+**/
+
+int octo_label_cmp(const void*a,const void*b){
+  const octo_label*x=a, *y=b;
+  if(x->value!=y->value)return x->value<y->value?-1:1;
+  return x->index-y->index;
+}
+void octo_index_program(octo_program*p){
+  int n=p->label_count=p->constants.keys.count;
+  p->labels=malloc((n?n:1)*sizeof(octo_label));
+  for(int z=0;z<n;z++){
+    p->labels[z].value=((octo_const*)octo_list_get(&p->constants.values,z))->value;
+    p->labels[z].index=z, p->labels[z].name=octo_list_get(&p->constants.keys,z);
+  }
+  qsort(p->labels,n,sizeof(octo_label),octo_label_cmp);
+  for(int z=0;z<p->aliases.keys.count;z++){
+    char*k=octo_list_get(&p->aliases.keys,z), *old;
+    int v=((octo_reg*)octo_list_get(&p->aliases.values,z))->value&0xF, len=strlen(k)+1;
+    if((old=p->register_aliases[v]))len+=strlen(old)+2;
+    char*names=malloc(len);
+    snprintf(names,len,"%s%s%s",old?old:"",old?", ":"",k);
+    free(old), p->register_aliases[v]=names;
+  }
+}
+char* octo_label_near(octo_program*p,double addr,int*offset){
+  // the name of an address and its distance from it, or NULL if nothing is near enough
+  int lo=0, hi=p->label_count;
+  while(lo<hi){int m=(lo+hi)/2; if(p->labels[m].value<=addr)lo=m+1; else hi=m;}
+  if(lo==0)return NULL;
+  double v=p->labels[lo-1].value;
+  if(addr-v>=0xFFFF)return NULL;
+  for(hi=lo-1,lo=0;lo<hi;){int m=(lo+hi)/2; if(p->labels[m].value<v)lo=m+1; else hi=m;}
+  *offset=(int)(addr-v);
+  return p->labels[lo].name;
+}
+
 /**
 *
 *  Tokenization
@@ -250,21 +428,24 @@ void octo_free_program(octo_program*p){
 **/
 
 int octo_interned_len(char* name){
-  return (name[-2]<<8)|name[-1];
+  return ((0xFF&name[-2])<<8)|(0xFF&name[-1]);
+}
+int octo_keyword_id(char* name){
+  return 0xFF&name[-3];
 }
 char* octo_intern_counted(octo_program* p,char* name,int length){
-  size_t index=2;
+  size_t index=3;
   while(index<p->strings_used) {
-    if(memcmp(name,p->strings+index,length+1)==0) return p->strings+index;
-    index+=octo_interned_len(p->strings+index)+3; // [ \0 , len-lo , len-hi ]
+    if(octo_interned_len(p->strings+index)==length&&memcmp(name,p->strings+index,length)==0) return p->strings+index;
+    index+=octo_interned_len(p->strings+index)+4; // [ \0 , keyword , len-lo , len-hi ]
   }
-  if(p->strings_used+length+1>=OCTO_INTERN_MAX){
+  if(p->strings_used+length+3>=OCTO_INTERN_MAX){
     return p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Internal Error: exhausted string interning table."), "";
   }
   memcpy(p->strings+index,name,length);
   p->strings[index-2]=0xFF&(length>>8);
   p->strings[index-1]=0xFF&length;
-  p->strings_used+=length+3;
+  p->strings_used+=length+4;
   return p->strings+index;
 }
 char* octo_intern(octo_program* p, char* name){
@@ -272,18 +453,18 @@ char* octo_intern(octo_program* p, char* name){
 }
 
 int octo_is_end(octo_program*p) {
-  return p->tokens.count==0 && p->source[0]=='\0';
+  return p->tokens.count==0 && p->source>=p->source_end;
 }
 char octo_next_char(octo_program*p) {
+  if(p->source>=p->source_end) return '\0';
   char c=p->source[0];
-  if(c=='\0') return '\0';
   if(c=='\n') p->source_line++, p->source_pos=0;
   else                          p->source_pos++;
   p->source++;
   return c;
 }
 char octo_peek_char(octo_program*p) {
-  return p->source[0]=='\0'?'\0' : p->source[0];
+  return p->source>=p->source_end?'\0' : p->source[0];
 }
 void octo_skip_whitespace(octo_program*p) {
   while(1){
@@ -304,16 +485,16 @@ void octo_fetch_token(octo_program*p) {
   if(octo_is_end(p)){p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Unexpected EOF.");return;}
   if(p->is_error) return;
   octo_tok* t=malloc(sizeof(octo_tok));
-  octo_list_append(&p->tokens, t);
-  t->line=p->source_line, t->pos=p->source_pos;
-  char str_buffer[4096]; int index=0;
-  if(p->source[0]=='"'){
+  octo_list_insert(&p->tokens, t, 0);
+  t->file=p->source_file, t->line=p->source_line, t->pos=p->source_pos, t->kw=0, t->slot=-1;
+  char str_buffer[4096]; int index=0; // unescaped string literals and numbers
+  if(octo_peek_char(p)=='"'){
     octo_next_char(p);
     while(1){
       char c=octo_next_char(p);
       if(c=='\0'){
         p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Missing a closing \" in a string literal.");
-        p->error_line=p->source_line, p->error_pos=p->source_pos;
+        p->error_line=p->source_line, p->error_pos=p->source_pos, p->error_file=p->source_file;
         return;
       }
       if(c=='"'){
@@ -324,7 +505,7 @@ void octo_fetch_token(octo_program*p) {
         char ec=octo_next_char(p);
         if(ec=='\0'){
           p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Missing a closing \" in a string literal.");
-          p->error_line=p->source_line, p->error_pos=p->source_pos;
+          p->error_line=p->source_line, p->error_pos=p->source_pos, p->error_file=p->source_file;
           return;
         }
         if      (ec=='t' ) str_buffer[index++]='\t';
@@ -336,7 +517,7 @@ void octo_fetch_token(octo_program*p) {
         else if (ec=='"' ) str_buffer[index++]='"';
         else{
           p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Unrecognized escape character '%c' in a string literal.",ec);
-          p->error_line=p->source_line, p->error_pos=p->source_pos-1;
+          p->error_line=p->source_line, p->error_pos=p->source_pos-1, p->error_file=p->source_file;
           return;
         }
       }
@@ -345,39 +526,43 @@ void octo_fetch_token(octo_program*p) {
       }
       if(index>=4095){
         p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"String literals must be < 4096 characters long.");
-        p->error_line=p->source_line, p->error_pos=p->source_pos;
+        p->error_line=p->source_line, p->error_pos=p->source_pos, p->error_file=p->source_file;
       }
     }
     str_buffer[index++]='\0';
     t->type=OCTO_TOK_STR, t->str_value=octo_intern_counted(p,str_buffer,index-1);
+    t->kw=p->is_error?0:octo_keyword_id(t->str_value);
   }
   else{
-    // string or number
+    // string or number. names are interned straight from the source;
+    // only tokens which strtod() might accept are copied out to parse.
+    char*start=p->source; int length=0;
     while(1){
       char c=octo_next_char(p);
       if (c==' '||c=='\t'||c=='\r'||c=='\n'||c=='#'||c=='\0')break;
-      str_buffer[index++]=c;
+      length++;
     }
-    str_buffer[index++]='\0';
-    char* float_end;
-    double float_val=strtod(str_buffer,&float_end);
-    if(float_end[0]=='\0'){
+    int copied=length<(int)sizeof(str_buffer)&&(length==0||strchr("+-.0123456789iInN\v\f",start[0]));
+    char* float_end=""; double float_val=0;
+    if(copied) memcpy(str_buffer,start,length), str_buffer[length]='\0', float_val=strtod(str_buffer,&float_end);
+    if(copied&&float_end[0]=='\0'){
       t->type=OCTO_TOK_NUM, t->num_value=float_val;
     }
-    else if(str_buffer[0]=='0'&&str_buffer[1]=='b'){
+    else if(copied&&str_buffer[0]=='0'&&str_buffer[1]=='b'){
       t->type=OCTO_TOK_NUM, t->num_value=strtol(str_buffer+2,NULL,2);
     }
-    else if(str_buffer[0]=='0'&&str_buffer[1]=='x'){
+    else if(copied&&str_buffer[0]=='0'&&str_buffer[1]=='x'){
       t->type=OCTO_TOK_NUM, t->num_value=strtol(str_buffer+2,NULL,16);
     }
-    else if(str_buffer[0]=='-'&&str_buffer[1]=='0'&&str_buffer[2]=='b'){
+    else if(copied&&str_buffer[0]=='-'&&str_buffer[1]=='0'&&str_buffer[2]=='b'){
       t->type=OCTO_TOK_NUM, t->num_value=-strtol(str_buffer+3,NULL,2);
     }
-    else if(str_buffer[0]=='-'&&str_buffer[1]=='0'&&str_buffer[2]=='x'){
+    else if(copied&&str_buffer[0]=='-'&&str_buffer[1]=='0'&&str_buffer[2]=='x'){
       t->type=OCTO_TOK_NUM, t->num_value=-strtol(str_buffer+3,NULL,16);
     }
     else{
-      t->type=OCTO_TOK_STR, t->str_value=octo_intern(p,str_buffer);
+      t->type=OCTO_TOK_STR, t->str_value=octo_intern_counted(p,start,length);
+      t->kw=p->is_error?0:octo_keyword_id(t->str_value);
     }
     // this is handy for debugging internal errors:
     // if (t->type==OCTO_TOK_STR) printf("RAW TOKEN: %p %s\n", (void*)t->str_value, t->str_value);
@@ -388,44 +573,209 @@ void octo_fetch_token(octo_program*p) {
 octo_tok* octo_next(octo_program*p) {
   if(p->tokens.count==0) octo_fetch_token(p);
   if(p->is_error) return octo_make_tok_null(p->source_line,p->source_pos);
-  octo_tok*r=octo_list_remove(&p->tokens,0);
-  p->error_line=r->line, p->error_pos=r->pos;
+  octo_tok*r=octo_list_remove(&p->tokens,p->tokens.count-1);
+  p->error_line=r->line, p->error_pos=r->pos, p->error_file=r->file;
   return r;
 }
 octo_tok* octo_peek(octo_program*p) {
   if(p->tokens.count==0) octo_fetch_token(p);
   if(p->is_error) return octo_make_tok_null(p->source_line,p->source_pos);
-  return octo_list_get(&p->tokens,0);
+  return octo_list_get(&p->tokens,p->tokens.count-1);
 }
-int octo_peek_match(octo_program*p,char*name,int index){
+int octo_peek_kw(octo_program*p,int index){
   while(!p->is_error&&!octo_is_end(p)&&p->tokens.count<index+1) octo_fetch_token(p);
-  if(octo_is_end(p)||p->is_error) return 0;
-  octo_tok*t=octo_list_get(&p->tokens,index);
-  return t->type==OCTO_TOK_STR&&strcmp(t->str_value,name)==0;
+  if(p->is_error||p->tokens.count<index+1) return OCTO_KW_NONE;
+  return ((octo_tok*)octo_list_get(&p->tokens,p->tokens.count-1-index))->kw;
+}
+int octo_peek_match(octo_program*p,int kw,int index){
+  return octo_peek_kw(p,index)==kw;
 }
-int octo_match(octo_program*p,char*name){
-  if(octo_peek_match(p,name,0)) return octo_free_tok(octo_next(p)),1;
+int octo_match(octo_program*p,int kw){
+  if(octo_peek_match(p,kw,0)) return octo_free_tok(octo_next(p)),1;
   return 0;
 }
 
+/**
+*
+*  Includes
+*
+*  ':include "path"' splices the tokens of another file into
+*  the stream in place of the statement. paths are relative to
+*  the file which holds the statement. tokens are cached for
+*  the life of the process, keyed by the resolved path; a file
+*  whose size and mtime are unchanged is not read again, and
+*  one whose text hashes the same is not tokenized again.
+*  the cache is shared, so compiles should not run in parallel.
+*
+**/
+
+#define OCTO_INCLUDE_MAX  256       // files per program
+#define OCTO_INCLUDE_SIZE (1<<20)   // bytes per file
+
+typedef struct {
+  char*     path;
+  time_t    mtime;
+  long      size;
+  unsigned  hash;    // FNV-1a of the text
+  int       count;
+  octo_tok* tokens;  // in source order, with strings pointing into text
+  char*     text;    // each string as interned: [kw][len-hi][len-lo]chars\0
+} octo_included;
+
+octo_list octo_include_cache;
+
+unsigned octo_include_hash(char*text,size_t length){
+  unsigned h=2166136261u;
+  for(size_t z=0;z<length;z++)h=(h^(0xFF&text[z]))*16777619u;
+  return h;
+}
+char* octo_error_file(octo_program*p){
+  // the path of the :include holding the error, or NULL if it is in the source itself.
+  octo_file*f=p->error_file>0&&p->error_file<p->files.count?octo_list_get(&p->files,p->error_file):NULL;
+  return f?f->path:NULL;
+}
+octo_program* octo_program_path(octo_program*p,const char*path){
+  // name the source, so that its includes are found beside it.
+  octo_file*f=octo_list_get(&p->files,0);
+  free(f->path), f->path=path?strcpy(malloc(strlen(path)+1),path):NULL;
+  return p;
+}
+
+int octo_include_tokenize(octo_program*p,octo_included*c,char*text,size_t length,int file){
+  // run the tokenizer over text in place of the source, and keep what it produces in c.
+  char*source=p->source, *source_end=p->source_end;
+  int line=p->source_line, pos=p->source_pos, prior=p->source_file;
+  octo_list tokens=p->tokens;
+  octo_list_init(&p->tokens);
+  p->source=text, p->source_end=text+length, p->source_line=0, p->source_pos=0, p->source_file=file;
+  if(length>=3&&(unsigned char)text[0]==0xEF&&(unsigned char)text[1]==0xBB&&(unsigned char)text[2]==0xBF)p->source+=3; // UTF-8 BOM
+  octo_skip_whitespace(p);
+  // each token is fetched to the front of the (empty) stream, and moved out in source order
+  octo_list read;
+  octo_list_init(&read);
+  while(!p->is_error&&p->source<p->source_end){
+    octo_fetch_token(p);
+    if(!p->is_error)octo_list_append(&read,octo_list_remove(&p->tokens,0));
+  }
+  if(!p->is_error){
+    int n=read.count, size=0;
+    for(int z=0;z<n;z++){octo_tok*t=octo_list_get(&read,z);if(t->type==OCTO_TOK_STR)size+=octo_interned_len(t->str_value)+4;}
+    c->tokens=malloc((n+1)*sizeof(octo_tok)), c->text=malloc(size+1), c->count=n;
+    for(int z=0,at=0;z<n;z++){
+      octo_tok*t=octo_list_get(&read,z);
+      c->tokens[z]=*t;
+      if(t->type!=OCTO_TOK_STR)continue;
+      int len=octo_interned_len(t->str_value);
+      memcpy(c->text+at,t->str_value-3,len+4), c->tokens[z].str_value=c->text+at+3, at+=len+4;
+    }
+  }
+  octo_list_destroy(&read,OCTO_DESTRUCTOR(octo_free_tok));
+  octo_list_destroy(&p->tokens,OCTO_DESTRUCTOR(octo_free_tok));
+  p->tokens=tokens;
+  p->source=source, p->source_end=source_end, p->source_line=line, p->source_pos=pos, p->source_file=prior;
+  return !p->is_error;
+}
+void octo_include_splice(octo_program*p,octo_included*c,int file){
+  // the stream is reversed, so the last token goes on first
+  for(int z=c->count-1;z>=0&&!p->is_error;z--){
+    octo_tok*t=octo_tok_copy(&c->tokens[z]);
+    t->file=file;
+    if(t->type==OCTO_TOK_STR){
+      t->str_value=octo_intern_counted(p,t->str_value,octo_interned_len(t->str_value));
+      t->kw=p->is_error?0:octo_keyword_id(t->str_value);
+    }
+    octo_list_append(&p->tokens,t);
+  }
+}
+octo_included* octo_include_find(char*path){
+  if(octo_include_cache.data==NULL)octo_list_init(&octo_include_cache);
+  for(int z=0;z<octo_include_cache.count;z++){
+    octo_included*c=octo_list_get(&octo_include_cache,z);
+    if(!strcmp(c->path,path))return c;
+  }
+  octo_included*c=calloc(1,sizeof(octo_included));
+  c->path=strcpy(malloc(strlen(path)+1),path);
+  octo_list_append(&octo_include_cache,c);
+  return c;
+}
+
+void octo_include(octo_program*p,char*name){
+  // error locations are those of the path, until the file's own tokens are read.
+  if(p->is_error)return;
+  if(p->files.count>=OCTO_INCLUDE_MAX){
+    p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Programs may :include at most %d files.",OCTO_INCLUDE_MAX);
+    return;
+  }
+  clock_t start=p->timed?clock():0;
+  octo_file*from=octo_list_get(&p->files,p->error_file), *f=calloc(1,sizeof(octo_file));
+  char*slash=NULL;
+  if(name[0]!='/')for(char*c=from->path;c&&*c;c++)if(*c=='/'||*c=='\\')slash=c;
+  int n=slash?slash-from->path+1:0;
+  f->path=malloc(n+strlen(name)+1), memcpy(f->path,from->path,n), strcpy(f->path+n,name);
+  f->parent=p->error_file;
+  octo_list_append(&p->files,f);
+  int file=p->files.count-1;
+
+  struct stat st;
+  if(stat(f->path,&st)||!S_ISREG(st.st_mode)){
+    p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Unable to :include '%s'.",f->path);
+    return;
+  }
+  for(int a=f->parent;a>=0;a=a?((octo_file*)octo_list_get(&p->files,a))->parent:-1){
+    // a file may not include itself, however indirectly or by whatever path
+    octo_file*g=octo_list_get(&p->files,a);
+    int same=g->path&&!strcmp(g->path,f->path);
+#ifndef _WIN32
+    struct stat gs;
+    same|=g->path&&!stat(g->path,&gs)&&gs.st_dev==st.st_dev&&gs.st_ino==st.st_ino;
+#endif
+    if(!same)continue;
+    p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Recursive :include of '%s'.",f->path);
+    return;
+  }
+  if(st.st_size>OCTO_INCLUDE_SIZE){
+    p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"The file '%s' is too large to :include.",f->path);
+    return;
+  }
+  octo_included*c=octo_include_find(f->path);
+  if(c->tokens&&c->mtime==st.st_mtime&&c->size==(long)st.st_size)f->cached=1;
+  else{
+    FILE*in=fopen(f->path,"rb");
+    char*text=malloc(st.st_size+1);
+    size_t length=in?fread(text,1,st.st_size,in):0;
+    if(in)fclose(in);
+    if(length!=(size_t)st.st_size){
+      free(text);
+      p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Unable to :include '%s'.",f->path);
+      return;
+    }
+    unsigned hash=octo_include_hash(text,length);
+    if(c->tokens&&c->hash==hash)f->cached=1;
+    else{
+      free(c->tokens), free(c->text), c->tokens=NULL, c->text=NULL, c->count=0;
+      if(!octo_include_tokenize(p,c,text,length,file)){free(text);return;}
+      c->hash=hash;
+    }
+    c->mtime=st.st_mtime, c->size=st.st_size;
+    free(text);
+  }
+  f->tokens=c->count;
+  octo_include_splice(p,c,file);
+  if(p->timed){
+    // the time to read the file is its own, not that of the statement which included it
+    double t=(clock()-start)/(double)CLOCKS_PER_SEC;
+    f->seconds+=t, from->seconds-=t;
+  }
+}
+
 /**
 *
 *  Parsing
 *
 **/
 
-char* octo_reserved_words[]={
-  ":=","|=","&=","^=","-=","=-","+=",">>=","<<=","==","!=","<",">",
-  "<=",">=","key","-key","hex","bighex","random","delay",":",":next",":unpack",
-  ":breakpoint",":proto",":alias",":const",":org",";","return","clear","bcd",
-  "save","load","buzzer","if","then","begin","else","end","jump","jump0",
-  "native","sprite","loop","while","again","scroll-down","scroll-up","scroll-right","scroll-left",
-  "lores","hires","loadflags","saveflags","i","audio","plane",":macro",":calc",":byte",
-  ":call",":stringmode",":assert",":monitor",":pointer","pitch",
-};
 int octo_is_reserved(char*name){
-  for(size_t z=0;z<sizeof(octo_reserved_words)/sizeof(char*);z++)if(strcmp(name,octo_reserved_words[z])==0)return 1;
-  return 0;
+  return octo_keywords[octo_keyword_id(name)].reserved;
 }
 int octo_check_name(octo_program*p,char*name,char*kind){
   if(p->is_error)return 0;
@@ -458,12 +808,12 @@ char* octo_identifier(octo_program*p,char*kind){
   if(!octo_check_name(p,n,kind))return "";
   return n;
 }
-void octo_expect(octo_program*p,char*name){
+void octo_expect(octo_program*p,int kw){
   if(p->is_error)return;
   octo_tok*t=octo_next(p);
-  if(t->type!=OCTO_TOK_STR||strcmp(t->str_value,name)!=0){
+  if(t->kw!=kw){
     char d[256];
-    p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Expected %s, got %s.",name,octo_tok_value(t,d));
+    p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Expected %s, got %s.",octo_keywords[kw].name,octo_tok_value(t,d));
   }
   octo_free_tok(t);
 }
@@ -492,6 +842,12 @@ int octo_register(octo_program*p){
   return octo_free_tok(t), isdigit(c)?c-'0': 10+(c-'a');
 }
 
+void octo_mark(octo_program*p,int addr,int flags){p->code[addr&0xFFFF]|=flags;}
+void octo_fixed(octo_program*p,int addr){
+  // the rom refers to addr by number, or by calculation.
+  // the interpreter's own memory below 0x200 never moves.
+  if(addr>=0x200)p->pinned=1, octo_mark(p,addr,OCTO_CODE_FIXED);
+}
 int octo_value_range(octo_program*p,int n,int mask){
   if(mask==0xF   &&(n<   0||n>mask)) p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Argument %d does not fit in 4 bits- must be in range [0,15].",n);
   if(mask==0xFF  &&(n<-128||n>mask)) p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Argument %d does not fit in a byte- must be in range [-128,255].",n);
@@ -514,7 +870,7 @@ int octo_value_4bit(octo_program*p){
   }
   char*n=t->str_value; octo_free_tok(t);
   octo_const*c=octo_map_get(&p->constants,n);
-  if(c!=NULL)return octo_value_range(p,c->value,0xF);
+  if(c!=NULL){if(c->is_label)octo_fixed(p,c->value);return octo_value_range(p,c->value,0xF);}
   return octo_value_fail(p,"a 4-bit",n,1),0;
 }
 int octo_value_8bit(octo_program*p){
@@ -526,7 +882,7 @@ int octo_value_8bit(octo_program*p){
   }
   char*n=t->str_value; octo_free_tok(t);
   octo_const*c=octo_map_get(&p->constants,n);
-  if(c!=NULL)return octo_value_range(p,c->value,0xFF);
+  if(c!=NULL){if(c->is_label)octo_fixed(p,c->value);return octo_value_range(p,c->value,0xFF);}
   return octo_value_fail(p,"an 8-bit",n,1),0;
 }
 int octo_value_12bit(octo_program*p){
@@ -534,29 +890,39 @@ int octo_value_12bit(octo_program*p){
   octo_tok*t=octo_next(p);
   if(t->type==OCTO_TOK_NUM){
     int n=t->num_value; octo_free_tok(t);
-    return octo_value_range(p,n,0xFFF);
+    return octo_fixed(p,n),octo_value_range(p,n,0xFFF);
   }
-  char*n=t->str_value; int proto_line=t->line, proto_pos=t->pos; octo_free_tok(t);
+  char*n=t->str_value; int proto_file=t->file, proto_line=t->line, proto_pos=t->pos; octo_free_tok(t);
   octo_const*c=octo_map_get(&p->constants,n);
-  if(c!=NULL)return octo_value_range(p,c->value,0xFFF);
+  if(c!=NULL){
+    if(c->is_label==1)octo_mark(p,p->here,OCTO_CODE_ADDR); else octo_fixed(p,c->value);
+    return octo_value_range(p,c->value,0xFFF);
+  }
   octo_value_fail(p,"a 12-bit",n,0);
   if(p->is_error)return 0;
   if(!octo_check_name(p,n,"label"))return 0;
   octo_proto*pr=octo_map_get(&p->protos,n);
-  if(pr==NULL)octo_map_set(&p->protos,n,pr=octo_make_proto(proto_line, proto_pos));
+  if(pr==NULL)octo_map_set(&p->protos,n,pr=octo_make_proto(proto_file,proto_line,proto_pos));
   octo_list_append(&pr->addrs,octo_make_pref(p->here,0));
+  octo_mark(p,p->here,OCTO_CODE_ADDR);
   return 0;
 }
 int octo_value_16bit(octo_program*p,int can_forward_ref,int offset){
+  // only values stored in the rom (at here+offset) can be forward references.
   if(p->is_error)return 0;
   octo_tok*t=octo_next(p);
   if(t->type==OCTO_TOK_NUM){
     int n=t->num_value; octo_free_tok(t);
+    if(can_forward_ref)octo_fixed(p,n);
     return octo_value_range(p,n,0xFFFF);
   }
-  char*n=t->str_value; int proto_line=t->line, proto_pos=t->pos; octo_free_tok(t);
+  char*n=t->str_value; int proto_file=t->file, proto_line=t->line, proto_pos=t->pos; octo_free_tok(t);
   octo_const*c=octo_map_get(&p->constants,n);
-  if(c!=NULL)return octo_value_range(p,c->value,0xFFFF);
+  if(c!=NULL){
+    if(can_forward_ref&&c->is_label==1)octo_mark(p,p->here+offset,OCTO_CODE_ADDR|OCTO_CODE_LONG);
+    else if(can_forward_ref)           octo_fixed(p,c->value);
+    return octo_value_range(p,c->value,0xFFFF);
+  }
   octo_value_fail(p,"a 16-bit",n,0);
   if(p->is_error)return 0;
   if(!octo_check_name(p,n,"label"))return 0;
@@ -565,8 +931,9 @@ int octo_value_16bit(octo_program*p,int can_forward_ref,int offset){
     return 0;
   }
   octo_proto*pr=octo_map_get(&p->protos,n);
-  if(pr==NULL)octo_map_set(&p->protos,n,pr=octo_make_proto(proto_line, proto_pos));
+  if(pr==NULL)octo_map_set(&p->protos,n,pr=octo_make_proto(proto_file,proto_line,proto_pos));
   octo_list_append(&pr->addrs,octo_make_pref(p->here+offset,1));
+  octo_mark(p,p->here+offset,OCTO_CODE_ADDR|OCTO_CODE_LONG);
   return 0;
 }
 octo_const* octo_value_constant(octo_program*p){
@@ -578,26 +945,46 @@ octo_const* octo_value_constant(octo_program*p){
   }
   char*n=t->str_value; octo_free_tok(t);
   octo_const*c=octo_map_get(&p->constants,n);
-  if(c!=NULL)return octo_make_const(c->value,0);
+  if(c!=NULL){octo_const*r=octo_make_const(c->value,0);r->is_label=c->is_label;return r;}
   if(octo_map_get(&p->protos,n)!=NULL) p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"A constant reference to '%s' may not be forward-declared.",n);
   return octo_value_fail(p,"a constant",n,1), octo_make_const(0,0);
 }
 
 void octo_macro_body(octo_program*p,char*desc,char*name,octo_macro*m){
   if(p->is_error)return;
-  octo_expect(p,"{");
+  octo_expect(p,OCTO_KW_LBRACE);
   if(p->is_error){snprintf(p->error,OCTO_ERR_MAX,"Expected '{' for definition of %s '%s'.",desc,name);return;}
   int depth=1;
   while(!octo_is_end(p)){
     octo_tok*t=octo_peek(p);
-    if(t->type==OCTO_TOK_STR&&strcmp(t->str_value,"{")==0)depth++;
-    if(t->type==OCTO_TOK_STR&&strcmp(t->str_value,"}")==0)depth--;
+    if(t->kw==OCTO_KW_LBRACE)depth++;
+    if(t->kw==OCTO_KW_RBRACE)depth--;
     if(depth==0)break;
     octo_list_append(&m->body,octo_next(p));
   }
-  octo_expect(p,"}");
+  octo_expect(p,OCTO_KW_RBRACE);
   if(p->is_error)snprintf(p->error,OCTO_ERR_MAX,"Expected '}' for definition of %s '%s'.",desc,name);
 }
+void octo_macro_slots(octo_macro*m,char**extra,int extras){
+  // resolve each body token to the binding which will replace it:
+  // slots [0,args) are the arguments, a later one shadowing an earlier
+  // one of the same name, and [args,args+extras) the implicit names.
+  for(int z=0;z<m->body.count;z++){
+    octo_tok*t=octo_list_get(&m->body,z);
+    t->slot=-1;
+    if(t->type!=OCTO_TOK_STR)continue;
+    for(int a=m->args.count-1;a>=0&&t->slot<0;a--)if(octo_list_get(&m->args,a)==t->str_value)t->slot=a;
+    for(int e=0;e<extras&&t->slot<0;e++)if(extra[e]==t->str_value)t->slot=m->args.count+e;
+  }
+}
+void octo_macro_expand(octo_program*p,octo_macro*m,octo_tok**bound){
+  // push the body onto the token stream, back to front, replacing
+  // each slotted token with its binding. unbound slots are NULL.
+  for(int z=m->body.count-1;z>=0;z--){
+    octo_tok*t=octo_list_get(&m->body,z), *r=t->slot<0?NULL:bound[t->slot];
+    octo_list_append(&p->tokens,octo_tok_copy(r==NULL?t:r));
+  }
+}
 
 /**
 *
@@ -606,80 +993,100 @@ void octo_macro_body(octo_program*p,char*desc,char*name,octo_macro*m){
 **/
 
 double octo_calc_expr(octo_program*p,char*name); // ooh, co-recursion!
+int octo_calc_peek(octo_program*p,int addr){
+  octo_mark(p,addr,OCTO_CODE_FIXED); // the byte must not change
+  return 0xFF&p->rom[addr&0xFFFF];
+}
 double octo_calc_terminal(octo_program*p,char*name){
   // NUMBER | CONSTANT | LABEL | VREGISTER | '(' expression ')'
   if(octo_peek_is_register(p))return octo_register(p);
-  if(octo_match(p,"PI"  ))return 3.141592653589793;
-  if(octo_match(p,"E"   ))return 2.718281828459045;
-  if(octo_match(p,"HERE"))return p->here;
+  if(octo_match(p,OCTO_KW_PI  ))return 3.141592653589793;
+  if(octo_match(p,OCTO_KW_E   ))return 2.718281828459045;
+  if(octo_match(p,OCTO_KW_HERE))return p->calc_label=1, p->here;
   octo_tok*t=octo_next(p);
   if(t->type==OCTO_TOK_NUM){
     double r=t->num_value;
     octo_free_tok(t);
     return r;
   }
-  char*n=t->str_value;
+  char*n=t->str_value; int kw=t->kw;
   octo_free_tok(t);
   if(octo_map_get(&p->protos,n)!=NULL){
     p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Cannot use forward declaration '%s' when calculating constant '%s'.",n,name);
     return 0;
   }
   octo_const*c=octo_map_get(&p->constants,n);
-  if(c!=NULL)return c->value;
-  if(strcmp(n,"(")!=0){
+  if(c!=NULL&&c->is_label==1)octo_mark(p,c->value,OCTO_CODE_FIXED);
+  if(c!=NULL)return p->calc_label|=c->is_label!=0, c->value;
+  if(kw!=OCTO_KW_LPAREN){
     p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Found undefined name '%s' when calculating constant '%s'.",n,name);
     return 0;
   }
   double r=octo_calc_expr(p,name);
-  octo_expect(p,")");
+  octo_expect(p,OCTO_KW_RPAREN);
   return r;
 }
 double octo_calc_expr(octo_program*p,char*name){
+  #define octo_op(k,e) case OCTO_KW_##k: octo_free_tok(octo_next(p)); return e;
   // UNARY expression
-  if(octo_match(p,"strlen")) return octo_interned_len(octo_string(p));
-  if(octo_match(p,"-"     )) return -octo_calc_expr(p,name);
-  if(octo_match(p,"~"     )) return ~((int)octo_calc_expr(p,name));
-  if(octo_match(p,"!"     )) return !((int)octo_calc_expr(p,name));
-  if(octo_match(p,"sin"   )) return sin(octo_calc_expr(p,name));
-  if(octo_match(p,"cos"   )) return cos(octo_calc_expr(p,name));
-  if(octo_match(p,"tan"   )) return tan(octo_calc_expr(p,name));
-  if(octo_match(p,"exp"   )) return exp(octo_calc_expr(p,name));
-  if(octo_match(p,"log"   )) return log(octo_calc_expr(p,name));
-  if(octo_match(p,"abs"   )) return fabs(octo_calc_expr(p,name));
-  if(octo_match(p,"sqrt"  )) return sqrt(octo_calc_expr(p,name));
-  if(octo_match(p,"sign"  )) return octo_sign(octo_calc_expr(p,name));
-  if(octo_match(p,"ceil"  )) return ceil(octo_calc_expr(p,name));
-  if(octo_match(p,"floor" )) return floor(octo_calc_expr(p,name));
-  if(octo_match(p,"@"     )) return 0xFF&(p->rom[0xFFFF&((int)octo_calc_expr(p,name))]);
+  switch(octo_peek_kw(p,0)){
+    octo_op(STRLEN, octo_interned_len(octo_string(p)))
+    octo_op(MINUS , -octo_calc_expr(p,name))
+    octo_op(BITNOT, ~((int)octo_calc_expr(p,name)))
+    octo_op(NOT   , !((int)octo_calc_expr(p,name)))
+    octo_op(SIN   , sin(octo_calc_expr(p,name)))
+    octo_op(COS   , cos(octo_calc_expr(p,name)))
+    octo_op(TAN   , tan(octo_calc_expr(p,name)))
+    octo_op(EXP   , exp(octo_calc_expr(p,name)))
+    octo_op(LOG   , log(octo_calc_expr(p,name)))
+    octo_op(ABS   , fabs(octo_calc_expr(p,name)))
+    octo_op(SQRT  , sqrt(octo_calc_expr(p,name)))
+    octo_op(SIGN  , octo_sign(octo_calc_expr(p,name)))
+    octo_op(CEIL  , ceil(octo_calc_expr(p,name)))
+    octo_op(FLOOR , floor(octo_calc_expr(p,name)))
+    octo_op(PEEK  , octo_calc_peek(p,octo_calc_expr(p,name)))
+  }
 
   // expression BINARY expression
   double r=octo_calc_terminal(p,name);
-  if(octo_match(p,"-"     )) return r-octo_calc_expr(p,name);
-  if(octo_match(p,"+"     )) return r+octo_calc_expr(p,name);
-  if(octo_match(p,"*"     )) return r*octo_calc_expr(p,name);
-  if(octo_match(p,"/"     )) return r/octo_calc_expr(p,name);
-  if(octo_match(p,"%"     )) return ((int)r)%((int)octo_calc_expr(p,name));
-  if(octo_match(p,"&"     )) return ((int)r)&((int)octo_calc_expr(p,name));
-  if(octo_match(p,"|"     )) return ((int)r)|((int)octo_calc_expr(p,name));
-  if(octo_match(p,"^"     )) return ((int)r)^((int)octo_calc_expr(p,name));
-  if(octo_match(p,"<<"    )) return ((int)r)<<((int)octo_calc_expr(p,name));
-  if(octo_match(p,">>"    )) return ((int)r)>>((int)octo_calc_expr(p,name));
-  if(octo_match(p,"pow"   )) return pow(r,octo_calc_expr(p,name));
-  if(octo_match(p,"min"   )) return octo_min(r,octo_calc_expr(p,name));
-  if(octo_match(p,"max"   )) return octo_max(r,octo_calc_expr(p,name));
-  if(octo_match(p,"<"     )) return r<octo_calc_expr(p,name);
-  if(octo_match(p,">"     )) return r>octo_calc_expr(p,name);
-  if(octo_match(p,"<="    )) return r<=octo_calc_expr(p,name);
-  if(octo_match(p,">="    )) return r>=octo_calc_expr(p,name);
-  if(octo_match(p,"=="    )) return r==octo_calc_expr(p,name);
-  if(octo_match(p,"!="    )) return r!=octo_calc_expr(p,name);
+  switch(octo_peek_kw(p,0)){
+    octo_op(MINUS , r-octo_calc_expr(p,name))
+    octo_op(PLUS  , r+octo_calc_expr(p,name))
+    octo_op(TIMES , r*octo_calc_expr(p,name))
+    octo_op(DIVIDE, r/octo_calc_expr(p,name))
+    octo_op(MOD   , ((int)r)%((int)octo_calc_expr(p,name)))
+    octo_op(BITAND, ((int)r)&((int)octo_calc_expr(p,name)))
+    octo_op(BITOR , ((int)r)|((int)octo_calc_expr(p,name)))
+    octo_op(BITXOR, ((int)r)^((int)octo_calc_expr(p,name)))
+    octo_op(SHL   , ((int)r)<<((int)octo_calc_expr(p,name)))
+    octo_op(SHR   , ((int)r)>>((int)octo_calc_expr(p,name)))
+    octo_op(POW   , pow(r,octo_calc_expr(p,name)))
+    octo_op(MIN   , octo_min(r,octo_calc_expr(p,name)))
+    octo_op(MAX   , octo_max(r,octo_calc_expr(p,name)))
+    octo_op(LT    , r<octo_calc_expr(p,name))
+    octo_op(GT    , r>octo_calc_expr(p,name))
+    octo_op(LE    , r<=octo_calc_expr(p,name))
+    octo_op(GE    , r>=octo_calc_expr(p,name))
+    octo_op(EQ    , r==octo_calc_expr(p,name))
+    octo_op(NE    , r!=octo_calc_expr(p,name))
+  }
+  #undef octo_op
   // terminal
   return r;
 }
 double octo_calculated(octo_program*p,char*name){
-  octo_expect(p,"{");
+  p->calc_label=0;
+  octo_expect(p,OCTO_KW_LBRACE);
   double r=octo_calc_expr(p,name);
-  octo_expect(p,"}");
+  octo_expect(p,OCTO_KW_RBRACE);
+  return r;
+}
+int octo_calculated_rom(octo_program*p,int address){
+  // an anonymous calculation stored in the rom. if it is an address, or
+  // is calculated from one, the rom can no longer be relocated.
+  int r=octo_calculated(p,"ANONYMOUS");
+  if(address)octo_fixed(p,r);
+  else if(p->calc_label)p->pinned=1;
   return r;
 }
 
@@ -702,6 +1109,7 @@ void octo_append(octo_program*p, char byte){
   p->rom[p->here]=byte, p->used[p->here]=1, p->here++;
 }
 void octo_instruction(octo_program*p, char a, char b){
+  octo_mark(p, p->here, OCTO_CODE_OP);
   octo_append(p, a), octo_append(p, b);
 }
 void octo_immediate(octo_program*p, char op, int nnn){
@@ -709,6 +1117,7 @@ void octo_immediate(octo_program*p, char op, int nnn){
 }
 void octo_jump(octo_program*p, int addr, int dest){
   if (p->is_error) return;
+  octo_mark(p, addr, OCTO_CODE_ADDR);
   p->rom[addr  ]=(0x10 | ((dest >> 8) & 0xF)), p->used[addr  ]=1;
   p->rom[addr+1]=(dest & 0xFF),                p->used[addr+1]=1;
 }
@@ -730,22 +1139,22 @@ void octo_conditional(octo_program*p,int negated){
   octo_tok*t=octo_peek(p);
   char d[256]; octo_tok_value(t,d);
   if(p->is_error)return;
-  char* n=octo_string(p);
-  #define octo_ca(pos,neg) (strcmp(n,negated?neg:pos)==0)
-  if(octo_ca("==","!=")){
+  int kw=t->kw; octo_string(p);
+  #define octo_ca(pos,neg) (kw==(negated?OCTO_KW_##neg:OCTO_KW_##pos))
+  if(octo_ca(EQ,NE)){
     if(octo_peek_is_register(p))octo_instruction(p, 0x90|reg, octo_register(p)<<4);
     else                        octo_instruction(p, 0x40|reg, octo_value_8bit(p));
   }
-  else if(octo_ca("!=","==")){
+  else if(octo_ca(NE,EQ)){
     if(octo_peek_is_register(p))octo_instruction(p, 0x50|reg, octo_register(p)<<4);
     else                        octo_instruction(p, 0x30|reg, octo_value_8bit(p));
   }
-  else if(octo_ca("key","-key"))octo_instruction(p, 0xE0|reg, 0xA1);
-  else if(octo_ca("-key","key"))octo_instruction(p, 0xE0|reg, 0x9E);
-  else if(octo_ca(">","<="))octo_pseudo_conditional(p,reg,0x5,0x4F);
-  else if(octo_ca("<",">="))octo_pseudo_conditional(p,reg,0x7,0x4F);
-  else if(octo_ca(">=","<"))octo_pseudo_conditional(p,reg,0x7,0x3F);
-  else if(octo_ca("<=",">"))octo_pseudo_conditional(p,reg,0x5,0x3F);
+  else if(octo_ca(KEY,NKEY))octo_instruction(p, 0xE0|reg, 0xA1);
+  else if(octo_ca(NKEY,KEY))octo_instruction(p, 0xE0|reg, 0x9E);
+  else if(octo_ca(GT,LE))octo_pseudo_conditional(p,reg,0x5,0x4F);
+  else if(octo_ca(LT,GE))octo_pseudo_conditional(p,reg,0x7,0x4F);
+  else if(octo_ca(GE,LT))octo_pseudo_conditional(p,reg,0x7,0x3F);
+  else if(octo_ca(LE,GT))octo_pseudo_conditional(p,reg,0x5,0x3F);
   else{
     p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Expected conditional operator, got %s.",d);
   }
@@ -763,10 +1172,12 @@ void octo_resolve_label(octo_program*p,int offset){
   }
   if((target==0x202||target==0x200)&&(strcmp(n,"main")==0)){
     p->has_main=0, p->here=target=0x200;
-    p->rom[0x200]=0, p->used[0x200]=0;
+    p->rom[0x200]=0, p->used[0x200]=0, p->code[0x200]&=~OCTO_CODE_OP;
     p->rom[0x201]=0, p->used[0x201]=0;
   }
-  octo_map_set(&p->constants,n,octo_make_const(target,0));
+  octo_const*c=octo_make_const(target,0);
+  c->is_label=1;
+  octo_map_set(&p->constants,n,c);
   if(octo_map_get(&p->protos,n)==NULL)return;
 
   octo_proto*pr=octo_map_remove(&p->protos,n);
@@ -798,330 +1209,374 @@ void octo_resolve_label(octo_program*p,int offset){
 
 void octo_compile_statement(octo_program*p){
   if(p->is_error)return;
-  int peek_line=octo_peek(p)->line, peek_pos=octo_peek(p)->pos;
+  int peek_file=octo_peek(p)->file, peek_line=octo_peek(p)->line, peek_pos=octo_peek(p)->pos;
   if(octo_peek_is_register(p)){
     int r=octo_register(p);
-    if(octo_match(p,":=")){
-      if(octo_peek_is_register(p))     octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x0);
-      else if (octo_match(p,"random")) octo_instruction(p, 0xC0|r, octo_value_8bit(p));
-      else if (octo_match(p,"key"   )) octo_instruction(p, 0xF0|r, 0x0A);
-      else if (octo_match(p,"delay" )) octo_instruction(p, 0xF0|r, 0x07);
-      else                             octo_instruction(p, 0x60|r, octo_value_8bit(p));
-    }
-    else if(octo_match(p,"+=")){
-      if(octo_peek_is_register(p))     octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x4);
-      else                             octo_instruction(p, 0x70|r, octo_value_8bit(p));
-    }
-    else if(octo_match(p,"-=")){
-      if(octo_peek_is_register(p))     octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x5);
-      else                             octo_instruction(p, 0x70|r, 1+~octo_value_8bit(p));
-    }
-    else if(octo_match(p,"|=" ))       octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x1);
-    else if(octo_match(p,"&=" ))       octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x2);
-    else if(octo_match(p,"^=" ))       octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x3);
-    else if(octo_match(p,"=-" ))       octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x7);
-    else if(octo_match(p,">>="))       octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x6);
-    else if(octo_match(p,"<<="))       octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0xE);
-    else{
-      octo_tok*t=octo_next(p); char d[256];
-      if(!p->is_error) p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Unrecognized operator %s.",octo_tok_value(t,d));
-      octo_free_tok(t);
+    octo_tok*t=octo_next(p);
+    switch(t->kw){
+      case OCTO_KW_ASSIGN:
+        if(octo_peek_is_register(p))          octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x0);
+        else if(octo_match(p,OCTO_KW_RANDOM)) octo_instruction(p, 0xC0|r, octo_value_8bit(p));
+        else if(octo_match(p,OCTO_KW_KEY   )) octo_instruction(p, 0xF0|r, 0x0A);
+        else if(octo_match(p,OCTO_KW_DELAY )) octo_instruction(p, 0xF0|r, 0x07);
+        else                                  octo_instruction(p, 0x60|r, octo_value_8bit(p));
+        break;
+      case OCTO_KW_ADD_ASSIGN:
+        if(octo_peek_is_register(p))          octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x4);
+        else                                  octo_instruction(p, 0x70|r, octo_value_8bit(p));
+        break;
+      case OCTO_KW_SUB_ASSIGN:
+        if(octo_peek_is_register(p))          octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x5);
+        else                                  octo_instruction(p, 0x70|r, 1+~octo_value_8bit(p));
+        break;
+      case OCTO_KW_OR_ASSIGN:   octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x1); break;
+      case OCTO_KW_AND_ASSIGN:  octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x2); break;
+      case OCTO_KW_XOR_ASSIGN:  octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x3); break;
+      case OCTO_KW_RSUB_ASSIGN: octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x7); break;
+      case OCTO_KW_SHR_ASSIGN:  octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0x6); break;
+      case OCTO_KW_SHL_ASSIGN:  octo_instruction(p, 0x80|r, (octo_register(p)<<4)|0xE); break;
+      default:{
+        char d[256];
+        if(!p->is_error) p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Unrecognized operator %s.",octo_tok_value(t,d));
+      }
     }
+    octo_free_tok(t);
     return;
   }
-  if(octo_match(p,":"))octo_resolve_label(p,0);
-  else if(octo_match(p,":next"))octo_resolve_label(p,1);
-  else if(octo_match(p,":unpack")){
-    int a=0;
-    if(octo_match(p,"long")){a=octo_value_16bit(p,1,0);}
-    else{int v=octo_value_4bit(p);a=(v<<12)|octo_value_12bit(p);}
-    octo_reg*rh=octo_map_get(&p->aliases,octo_intern(p,"unpack-hi"));
-    octo_reg*rl=octo_map_get(&p->aliases,octo_intern(p,"unpack-lo"));
-    octo_instruction(p, 0x60|rh->value, a>>8);
-    octo_instruction(p, 0x60|rl->value, a);
-  }
-  else if(octo_match(p,":breakpoint")) p->breakpoints[p->here]=octo_string(p);
-  else if(octo_match(p,":monitor")) {
-    char n[256]; octo_mon*m=octo_make_mon();
-    octo_tok_value(octo_peek(p),n);
-    if(octo_peek_is_register(p)){
-      m->type=0; // register monitor
-      m->base=octo_register(p);
-      if(octo_peek(p)->type==OCTO_TOK_NUM) m->len=octo_value_4bit(p),m->format=NULL;
-      else                                 m->len=-1,m->format=octo_string(p);
+  int kw=octo_peek_kw(p,0);
+  if(octo_keywords[kw].statement)octo_free_tok(octo_next(p));
+  switch(kw){
+    case OCTO_KW_LABEL:                   octo_resolve_label(p,0); break;
+    case OCTO_KW_NEXT:                    octo_resolve_label(p,1); break;
+    case OCTO_KW_UNPACK:{
+      int a=0;
+      if(octo_match(p,OCTO_KW_LONG)){a=octo_value_16bit(p,1,0);}
+      else{int v=octo_value_4bit(p);a=(v<<12)|octo_value_12bit(p);}
+      octo_reg*rh=octo_map_get(&p->aliases,octo_intern(p,"unpack-hi"));
+      octo_reg*rl=octo_map_get(&p->aliases,octo_intern(p,"unpack-lo"));
+      octo_instruction(p, 0x60|rh->value, a>>8);
+      octo_instruction(p, 0x60|rl->value, a);
+      break;
     }
-    else{
-      m->type=1; // memory monitor
-      m->base=octo_value_16bit(p,0,0);
-      if(octo_peek(p)->type==OCTO_TOK_NUM) m->len=octo_value_16bit(p,0,0),m->format=NULL;
-      else                                 m->len=-1,m->format=octo_string(p);
+    case OCTO_KW_BREAKPOINT:              octo_set_breakpoint(p,p->here,octo_string(p)); break;
+    case OCTO_KW_INCLUDE:                 octo_include(p,octo_string(p)); break;
+    case OCTO_KW_MONITOR:{
+      char n[256]; octo_mon*m=octo_make_mon();
+      octo_tok_value(octo_peek(p),n);
+      if(octo_peek_is_register(p)){
+        m->type=0; // register monitor
+        m->base=octo_register(p);
+        if(octo_peek(p)->type==OCTO_TOK_NUM) m->len=octo_value_4bit(p),m->format=NULL;
+        else                                 m->len=-1,m->format=octo_string(p);
+      }
+      else{
+        m->type=1; // memory monitor
+        m->base=octo_value_16bit(p,0,0);
+        if(octo_peek(p)->type==OCTO_TOK_NUM) m->len=octo_value_16bit(p,0,0),m->format=NULL;
+        else                                 m->len=-1,m->format=octo_string(p);
+      }
+      if(n[strlen(n)-1]=='\'')n[strlen(n)-1]='\0';
+      char* nn=octo_intern(p,n[0]=='\''?n+1:n);
+      octo_map_set(&p->monitors,nn,m);
+      break;
     }
-    if(n[strlen(n)-1]=='\'')n[strlen(n)-1]='\0';
-    char* nn=octo_intern(p,n[0]=='\''?n+1:n);
-    octo_map_set(&p->monitors,nn,m);
-  }
-  else if(octo_match(p,":assert")) {
-    char*message=octo_peek_match(p,"{",0)?NULL:octo_string(p);
-    if(!octo_calculated(p,"assertion")){
-      p->is_error=1;
-      if (message!=NULL) snprintf(p->error,OCTO_ERR_MAX,"Assertion failed: %s",message);
-      else               snprintf(p->error,OCTO_ERR_MAX,"Assertion failed.");
+    case OCTO_KW_WATCH: case OCTO_KW_WATCH_READ:{
+      int read=kw==OCTO_KW_WATCH_READ, base=octo_value_16bit(p,0,0), len=octo_value_16bit(p,0,0);
+      octo_list_append(&p->watches,octo_make_watch(base,len,read));
+      break;
     }
-  }
-  else if(octo_match(p,":proto"))octo_free_tok(octo_next(p));//deprecated
-  else if(octo_match(p,":alias")){
-    char*n=octo_identifier(p,"alias");
-    if(octo_map_get(&p->constants,n)!=NULL){p->is_error=1,snprintf(p->error,OCTO_ERR_MAX,"The name '%s' is already used by a constant.",n);return;}
-    int v=octo_peek_match(p,"{",0)?octo_calculated(p,"ANONYMOUS"):octo_register(p);
-    if(v<0||v>15){p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Register index must be in the range [0,F].");return;}
-    octo_reg*prev=octo_map_set(&p->aliases,n,octo_make_reg(v));
-    if(prev!=NULL)octo_free_reg(prev);
-  }
-  else if(octo_match(p,":byte")){
-    octo_append(p, octo_peek_match(p,"{",0)?(int)octo_calculated(p,"ANONYMOUS"):octo_value_8bit(p));
-  }
-  else if(octo_match(p,":pointer")){
-    int a=octo_peek_match(p,"{",0)?octo_calculated(p,"ANONYMOUS"):octo_value_16bit(p,1,0);
-    octo_instruction(p,a>>8,a);
-  }
-  else if(octo_match(p,":org")){
-    p->here=(octo_peek_match(p,"{",0)?0xFFFF&(int)octo_calculated(p,"ANONYMOUS"):octo_value_16bit(p,0,0));
-  }
-  else if(octo_match(p,":call")){
-    octo_immediate(p,0x20,octo_peek_match(p,"{",0)?0xFFF&(int)octo_calculated(p,"ANONYMOUS"):octo_value_12bit(p));
-  }
-  else if(octo_match(p,":const")){
-    char*n=octo_identifier(p,"constant");
-    if(octo_map_get(&p->constants,n)!=NULL){p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"The name '%s' has already been defined.",n);return;}
-    octo_map_set(&p->constants,n,octo_value_constant(p));
-  }
-  else if(octo_match(p,":calc")){
-    char*n=octo_identifier(p,"calculated constant");
-    octo_const*prev=octo_map_get(&p->constants,n);
-    if(prev!=NULL&&!prev->is_mutable){p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Cannot redefine the name '%s' with :calc.",n);return;}
-    octo_map_set(&p->constants,n,octo_make_const(octo_calculated(p,n),1));
-    if(prev!=NULL)octo_free_const(prev);
-  }
-  else if(octo_match(p,";")||octo_match(p,"return")) octo_instruction(p, 0x00, 0xEE);
-  else if(octo_match(p,"clear"))        octo_instruction(p, 0x00, 0xE0);
-  else if(octo_match(p,"bcd"))          octo_instruction(p, 0xF0|octo_register(p), 0x33);
-  else if(octo_match(p,"delay"))        octo_expect(p,":="),octo_instruction(p, 0xF0|octo_register(p), 0x15);
-  else if(octo_match(p,"buzzer"))       octo_expect(p,":="),octo_instruction(p, 0xF0|octo_register(p), 0x18);
-  else if(octo_match(p,"pitch"))        octo_expect(p,":="),octo_instruction(p, 0xF0|octo_register(p), 0x3A);
-  else if(octo_match(p,"jump0"))        octo_immediate(p, 0xB0, octo_value_12bit(p));
-  else if(octo_match(p,"jump"))         octo_immediate(p, 0x10, octo_value_12bit(p));
-  else if(octo_match(p,"native"))       octo_immediate(p, 0x00, octo_value_12bit(p));
-  else if(octo_match(p,"audio"))        octo_instruction(p, 0xF0, 0x02);
-  else if(octo_match(p,"scroll-down"))  octo_instruction(p, 0x00, 0xC0|octo_value_4bit(p));
-  else if(octo_match(p,"scroll-up"))    octo_instruction(p, 0x00, 0xD0|octo_value_4bit(p));
-  else if(octo_match(p,"scroll-right")) octo_instruction(p, 0x00, 0xFB);
-  else if(octo_match(p,"scroll-left"))  octo_instruction(p, 0x00, 0xFC);
-  else if(octo_match(p,"exit"))         octo_instruction(p, 0x00, 0xFD);
-  else if(octo_match(p,"lores"))        octo_instruction(p, 0x00, 0xFE);
-  else if(octo_match(p,"hires"))        octo_instruction(p, 0x00, 0xFF);
-  else if(octo_match(p,"sprite")){
-    int x=octo_register(p),y=octo_register(p);octo_instruction(p,0xD0|x,(y<<4)|octo_value_4bit(p));
-  }
-  else if(octo_match(p,"plane")){
-    int n=octo_value_4bit(p);
-    if(n>3) p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"The plane bitmask must be [0,3], was %d.",n);
-    octo_instruction(p, 0xF0|n, 0x01);
-  }
-  else if(octo_match(p,"saveflags"))octo_instruction(p, 0xF0|octo_register(p), 0x75);
-  else if(octo_match(p,"loadflags"))octo_instruction(p, 0xF0|octo_register(p), 0x85);
-  else if(octo_match(p,"save")){
-    int r=octo_register(p);
-    if(octo_match(p,"-")) octo_instruction(p, 0x50|r, (octo_register(p)<<4)|0x02);
-    else                  octo_instruction(p, 0xF0|r, 0x55);
-  }
-  else if(octo_match(p,"load")){
-    int r=octo_register(p);
-    if(octo_match(p,"-")) octo_instruction(p, 0x50|r, (octo_register(p)<<4)|0x03);
-    else                  octo_instruction(p, 0xF0|r, 0x65);
-  }
-  else if(octo_match(p,"i")){
-    if(octo_match(p,":=")){
-      if(octo_match(p,"long")){
-        int a=octo_value_16bit(p,1,2);
-        octo_instruction(p,0xF0,0x00);
-        octo_instruction(p,(a>>8),a);
+    case OCTO_KW_ASSERT:{
+      char*message=octo_peek_match(p,OCTO_KW_LBRACE,0)?NULL:octo_string(p);
+      if(!octo_calculated(p,"assertion")){
+        p->is_error=1;
+        if (message!=NULL) snprintf(p->error,OCTO_ERR_MAX,"Assertion failed: %s",message);
+        else               snprintf(p->error,OCTO_ERR_MAX,"Assertion failed.");
       }
-      else if(octo_match(p,"hex"))    octo_instruction(p, 0xF0|octo_register(p), 0x29);
-      else if(octo_match(p,"bighex")) octo_instruction(p, 0xF0|octo_register(p), 0x30);
-      else                            octo_immediate(p, 0xA0, octo_value_12bit(p));
+      break;
     }
-    else if(octo_match(p,"+=")) octo_instruction(p, 0xF0|octo_register(p), 0x1E);
-    else{
-      octo_tok*t=octo_next(p); char d[256];
-      p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"%s is not an operator that can target the i register.",octo_tok_value(t,d));
-      octo_free_tok(t);
+    case OCTO_KW_PROTO:                   octo_free_tok(octo_next(p)); break; // deprecated
+    case OCTO_KW_ALIAS:{
+      char*n=octo_identifier(p,"alias");
+      if(octo_map_get(&p->constants,n)!=NULL){p->is_error=1,snprintf(p->error,OCTO_ERR_MAX,"The name '%s' is already used by a constant.",n);return;}
+      int v=octo_peek_match(p,OCTO_KW_LBRACE,0)?octo_calculated(p,"ANONYMOUS"):octo_register(p);
+      if(v<0||v>15){p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Register index must be in the range [0,F].");return;}
+      octo_reg*prev=octo_map_set(&p->aliases,n,octo_make_reg(v));
+      if(prev!=NULL)octo_free_reg(prev);
+      break;
     }
-  }
-  else if(octo_match(p,"if")){
-    int index=(octo_peek_match(p,"key",1)||octo_peek_match(p,"-key",1))?2: 3;
-    if(octo_peek_match(p,"then",index)){
-      octo_conditional(p,0), octo_expect(p,"then");
+    case OCTO_KW_BYTE:{
+      octo_append(p, octo_peek_match(p,OCTO_KW_LBRACE,0)?octo_calculated_rom(p,0):octo_value_8bit(p));
+      break;
     }
-    else if (octo_peek_match(p,"begin",index)){
-      octo_conditional(p,1), octo_expect(p,"begin");
-      octo_stack_push(&p->branches,octo_make_flow(p->here,p->source_line,p->source_pos,"begin"));
-      octo_instruction(p, 0x00, 0x00);
+    case OCTO_KW_POINTER:{
+      int a=octo_peek_match(p,OCTO_KW_LBRACE,0)?octo_calculated_rom(p,1):octo_value_16bit(p,1,0);
+      octo_append(p,a>>8), octo_append(p,a);
+      break;
     }
-    else{
-      for(int z=0;z<=index;z++) if(!octo_is_end(p)) octo_free_tok(octo_next(p));
-      p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Expected 'then' or 'begin'.");
+    case OCTO_KW_ORG:{
+      p->here=(octo_peek_match(p,OCTO_KW_LBRACE,0)?0xFFFF&(int)octo_calculated(p,"ANONYMOUS"):octo_value_16bit(p,0,0));
+      octo_mark(p,p->here,OCTO_CODE_ORG);
+      break;
     }
-  }
-  else if(octo_match(p,"else")){
-    if(octo_stack_is_empty(&p->branches)){
-      p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'else' does not have a matching 'begin'.");
-      return;
+    case OCTO_KW_CALL:{
+      octo_immediate(p,0x20,octo_peek_match(p,OCTO_KW_LBRACE,0)?0xFFF&octo_calculated_rom(p,1):octo_value_12bit(p));
+      break;
     }
-    octo_flow*f=octo_stack_pop(&p->branches);
-    octo_jump(p,f->addr,p->here+2); octo_free_flow(f);
-    octo_stack_push(&p->branches,octo_make_flow(p->here,peek_line,peek_pos,"else"));
-    octo_instruction(p, 0x00, 0x00);
-  }
-  else if(octo_match(p,"end")){
-    if(octo_stack_is_empty(&p->branches)){
-      p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'end' does not have a matching 'begin'.");
-      return;
+    case OCTO_KW_CONST:{
+      char*n=octo_identifier(p,"constant");
+      if(octo_map_get(&p->constants,n)!=NULL){p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"The name '%s' has already been defined.",n);return;}
+      octo_map_set(&p->constants,n,octo_value_constant(p));
+      break;
     }
-    octo_flow*f=octo_stack_pop(&p->branches);
-    octo_jump(p,f->addr,p->here); octo_free_flow(f);
-  }
-  else if(octo_match(p,"loop")){
-    octo_stack_push(&p->loops,octo_make_flow(p->here,peek_line,peek_pos,"loop"));
-    octo_stack_push(&p->whiles,octo_make_flow(-1,peek_line,peek_pos,"loop"));
-  }
-  else if(octo_match(p,"while")){
-    if(octo_stack_is_empty(&p->loops)){
-      p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'while' is not within a loop.");
-      return;
+    case OCTO_KW_CALC:{
+      char*n=octo_identifier(p,"calculated constant");
+      octo_const*prev=octo_map_get(&p->constants,n);
+      if(prev!=NULL&&!prev->is_mutable){p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Cannot redefine the name '%s' with :calc.",n);return;}
+      octo_const*c=octo_make_const(octo_calculated(p,n),1);
+      c->is_label=p->calc_label?2:0; // calculated from an address
+      octo_map_set(&p->constants,n,c);
+      if(prev!=NULL)octo_free_const(prev);
+      break;
     }
-    octo_conditional(p,1);
-    octo_stack_push(&p->whiles,octo_make_flow(p->here,peek_line,peek_pos,"while"));
-    octo_immediate(p, 0x10, 0); // forward jump
-  }
-  else if(octo_match(p,"again")){
-    if(octo_stack_is_empty(&p->loops)){
-      p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'again' does not have a matching 'loop'.");
-      return;
+    case OCTO_KW_SEMI: case OCTO_KW_RETURN: octo_instruction(p, 0x00, 0xEE); break;
+    case OCTO_KW_CLEAR:                   octo_instruction(p, 0x00, 0xE0); break;
+    case OCTO_KW_BCD:                     octo_instruction(p, 0xF0|octo_register(p), 0x33); break;
+    case OCTO_KW_DELAY:                   octo_expect(p,OCTO_KW_ASSIGN),octo_instruction(p, 0xF0|octo_register(p), 0x15); break;
+    case OCTO_KW_BUZZER:                  octo_expect(p,OCTO_KW_ASSIGN),octo_instruction(p, 0xF0|octo_register(p), 0x18); break;
+    case OCTO_KW_PITCH:                   octo_expect(p,OCTO_KW_ASSIGN),octo_instruction(p, 0xF0|octo_register(p), 0x3A); break;
+    case OCTO_KW_JUMP0:                   octo_immediate(p, 0xB0, octo_value_12bit(p)); break;
+    case OCTO_KW_JUMP:                    octo_immediate(p, 0x10, octo_value_12bit(p)); break;
+    case OCTO_KW_NATIVE:                  octo_immediate(p, 0x00, octo_value_12bit(p)); break;
+    case OCTO_KW_AUDIO:                   octo_instruction(p, 0xF0, 0x02); break;
+    case OCTO_KW_SCROLL_DOWN:             octo_instruction(p, 0x00, 0xC0|octo_value_4bit(p)); break;
+    case OCTO_KW_SCROLL_UP:               octo_instruction(p, 0x00, 0xD0|octo_value_4bit(p)); break;
+    case OCTO_KW_SCROLL_RIGHT:            octo_instruction(p, 0x00, 0xFB); break;
+    case OCTO_KW_SCROLL_LEFT:             octo_instruction(p, 0x00, 0xFC); break;
+    case OCTO_KW_EXIT:                    octo_instruction(p, 0x00, 0xFD); break;
+    case OCTO_KW_LORES:                   octo_instruction(p, 0x00, 0xFE); break;
+    case OCTO_KW_HIRES:                   octo_instruction(p, 0x00, 0xFF); break;
+    case OCTO_KW_SPRITE:{
+      int x=octo_register(p),y=octo_register(p);octo_instruction(p,0xD0|x,(y<<4)|octo_value_4bit(p));
+      break;
     }
-    octo_flow*f=octo_stack_pop(&p->loops);
-    octo_immediate(p,0x10,f->addr);
-    octo_free_flow(f);
-    while(1){
-      octo_flow*f=octo_stack_pop(&p->whiles);
-      int a=f->addr;octo_free_flow(f);
-      if(a==-1)break;
-      octo_jump(p,a,p->here);
+    case OCTO_KW_PLANE:{
+      int n=octo_value_4bit(p);
+      if(n>3) p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"The plane bitmask must be [0,3], was %d.",n);
+      octo_instruction(p, 0xF0|n, 0x01);
+      break;
     }
-  }
-  else if(octo_match(p,":macro")){
-    char*n=octo_identifier(p,"macro");
-    if(octo_map_get(&p->macros,n)){
-      p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"The name '%s' has already been defined.",n);
-      return;
+    case OCTO_KW_SAVEFLAGS:               octo_instruction(p, 0xF0|octo_register(p), 0x75); break;
+    case OCTO_KW_LOADFLAGS:               octo_instruction(p, 0xF0|octo_register(p), 0x85); break;
+    case OCTO_KW_SAVE:{
+      int r=octo_register(p);
+      if(octo_match(p,OCTO_KW_MINUS)) octo_instruction(p, 0x50|r, (octo_register(p)<<4)|0x02);
+      else                  octo_instruction(p, 0xF0|r, 0x55);
+      break;
     }
-    octo_macro*m=octo_make_macro();
-    octo_map_set(&p->macros,n,m);
-    while(!octo_is_end(p) && !octo_peek_match(p,"{",0)) octo_list_append(&m->args,octo_identifier(p,"macro argument"));
-    octo_macro_body(p,"macro",n,m);
-  }
-  else if(octo_match(p,":stringmode")){
-    char*n=octo_identifier(p,"stringmode");
-    if(octo_map_get(&p->stringmodes,n)==NULL)octo_map_set(&p->stringmodes,n,octo_make_smode());
-    octo_smode*s=octo_map_get(&p->stringmodes,n);
-    int alpha_base=p->source_pos, alpha_quote=octo_peek_char(p)=='"';
-    char*alphabet=octo_string(p);
-    octo_macro*m=octo_make_macro(); // every stringmode needs its own copy of this
-    octo_macro_body(p,"string mode",n,m);
-    for(int z=0;z<octo_interned_len(alphabet);z++){
-      int c=0xFF&alphabet[z];
-      if(s->modes[c]!=0){
-        p->error_pos=alpha_base+z+(alpha_quote?1:0);
-        p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"String mode '%s' is already defined for the character '%c'.",n,c);
-        break;
+    case OCTO_KW_LOAD:{
+      int r=octo_register(p);
+      if(octo_match(p,OCTO_KW_MINUS)) octo_instruction(p, 0x50|r, (octo_register(p)<<4)|0x03);
+      else                  octo_instruction(p, 0xF0|r, 0x65);
+      break;
+    }
+    case OCTO_KW_I:{
+      if(octo_match(p,OCTO_KW_ASSIGN)){
+        if(octo_match(p,OCTO_KW_LONG)){
+          int a=octo_value_16bit(p,1,2);
+          octo_instruction(p,0xF0,0x00);
+          octo_append(p,a>>8), octo_append(p,a);
+        }
+        else if(octo_match(p,OCTO_KW_HEX))    octo_instruction(p, 0xF0|octo_register(p), 0x29);
+        else if(octo_match(p,OCTO_KW_BIGHEX)) octo_instruction(p, 0xF0|octo_register(p), 0x30);
+        else                            octo_immediate(p, 0xA0, octo_value_12bit(p));
+      }
+      else if(octo_match(p,OCTO_KW_ADD_ASSIGN)) octo_instruction(p, 0xF0|octo_register(p), 0x1E);
+      else{
+        octo_tok*t=octo_next(p); char d[256];
+        p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"%s is not an operator that can target the i register.",octo_tok_value(t,d));
+        octo_free_tok(t);
       }
-      s->values[c]=z;
-      s->modes [c]=octo_make_macro();
-      octo_tok_list_insert(&s->modes[c]->body,&m->body,0);
+      break;
     }
-    octo_free_macro(m);
-  }
-  else{
-    octo_tok*t=octo_peek(p);
-    if(p->is_error)return;
-    if(t->type==OCTO_TOK_NUM){
-      int n=t->num_value; octo_free_tok(octo_next(p));
-      if(n<-128||n>255){
-        p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Literal value '%d' does not fit in a byte- must be in range [-128,255].",n);
+    case OCTO_KW_IF:{
+      int index=(octo_peek_match(p,OCTO_KW_KEY,1)||octo_peek_match(p,OCTO_KW_NKEY,1))?2: 3;
+      if(octo_peek_match(p,OCTO_KW_THEN,index)){
+        octo_conditional(p,0), octo_expect(p,OCTO_KW_THEN);
       }
-      octo_append(p,n);
-      return;
+      else if (octo_peek_match(p,OCTO_KW_BEGIN,index)){
+        octo_conditional(p,1), octo_expect(p,OCTO_KW_BEGIN);
+        int f=p->error_file; // where the 'begin' was read, if it came from an :include
+        octo_stack_push(&p->branches,octo_make_flow(p->here,f,f?p->error_line:p->source_line,f?p->error_pos:p->source_pos,"begin"));
+        octo_instruction(p, 0x00, 0x00);
+      }
+      else{
+        for(int z=0;z<=index;z++) if(!octo_is_end(p)) octo_free_tok(octo_next(p));
+        p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Expected 'then' or 'begin'.");
+      }
+      break;
     }
-    char*n=t->type==OCTO_TOK_STR?t->str_value:"";
-    if(octo_map_get(&p->macros,n)!=NULL){
-      octo_free_tok(octo_next(p));
-      octo_macro*m=octo_map_get(&p->macros,n);
-      octo_map bindings; // name -> tok
-      octo_map_init(&bindings);
-      octo_map_set(&bindings,octo_intern(p,"CALLS"),octo_make_tok_num(m->calls++));
-      for(int z=0;z<m->args.count;z++){
-        if(octo_is_end(p)){
-          p->error_line=p->source_line, p->error_pos=p->source_pos;
-          p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Not enough arguments for expansion of macro '%s'.",n);
-          break;
-        }
-        octo_map_set(&bindings,octo_list_get(&m->args,z),octo_next(p));
+    case OCTO_KW_ELSE:{
+      if(octo_stack_is_empty(&p->branches)){
+        p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'else' does not have a matching 'begin'.");
+        return;
       }
-      int splice_index=0;
-      for(int z=0;z<m->body.count;z++){
-        octo_tok*t=octo_list_get(&m->body,z);
-        octo_tok*r=(t->type==OCTO_TOK_STR)?octo_map_get(&bindings,t->str_value):NULL;
-        octo_list_insert(&p->tokens,octo_tok_copy(r==NULL?t:r),splice_index++);
+      octo_flow*f=octo_stack_pop(&p->branches);
+      octo_jump(p,f->addr,p->here+2); octo_free_flow(f);
+      octo_stack_push(&p->branches,octo_make_flow(p->here,peek_file,peek_line,peek_pos,"else"));
+      octo_instruction(p, 0x00, 0x00);
+      break;
+    }
+    case OCTO_KW_END:{
+      if(octo_stack_is_empty(&p->branches)){
+        p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'end' does not have a matching 'begin'.");
+        return;
       }
-      octo_map_destroy(&bindings,OCTO_DESTRUCTOR(octo_free_tok));
+      octo_flow*f=octo_stack_pop(&p->branches);
+      octo_jump(p,f->addr,p->here); octo_free_flow(f);
+      break;
+    }
+    case OCTO_KW_LOOP:{
+      octo_stack_push(&p->loops,octo_make_flow(p->here,peek_file,peek_line,peek_pos,"loop"));
+      octo_stack_push(&p->whiles,octo_make_flow(-1,peek_file,peek_line,peek_pos,"loop"));
+      break;
+    }
+    case OCTO_KW_WHILE:{
+      if(octo_stack_is_empty(&p->loops)){
+        p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'while' is not within a loop.");
+        return;
+      }
+      octo_conditional(p,1);
+      octo_stack_push(&p->whiles,octo_make_flow(p->here,peek_file,peek_line,peek_pos,"while"));
+      octo_immediate(p, 0x10, 0); // forward jump
+      break;
     }
-    else if (octo_map_get(&p->stringmodes,n)!=NULL){
-      octo_free_tok(octo_next(p));
+    case OCTO_KW_AGAIN:{
+      if(octo_stack_is_empty(&p->loops)){
+        p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'again' does not have a matching 'loop'.");
+        return;
+      }
+      octo_flow*f=octo_stack_pop(&p->loops);
+      octo_mark(p,p->here,OCTO_CODE_ADDR);
+      octo_immediate(p,0x10,f->addr);
+      octo_free_flow(f);
+      while(1){
+        octo_flow*f=octo_stack_pop(&p->whiles);
+        int a=f->addr;octo_free_flow(f);
+        if(a==-1)break;
+        octo_jump(p,a,p->here);
+      }
+      break;
+    }
+    case OCTO_KW_MACRO:{
+      char*n=octo_identifier(p,"macro");
+      if(octo_map_get(&p->macros,n)){
+        p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"The name '%s' has already been defined.",n);
+        return;
+      }
+      octo_macro*m=octo_make_macro();
+      octo_map_set(&p->macros,n,m);
+      while(!octo_is_end(p) && !octo_peek_match(p,OCTO_KW_LBRACE,0)) octo_list_append(&m->args,octo_identifier(p,"macro argument"));
+      octo_macro_body(p,"macro",n,m);
+      char*calls=octo_intern(p,"CALLS");
+      octo_macro_slots(m,&calls,1);
+      break;
+    }
+    case OCTO_KW_STRINGMODE:{
+      char*n=octo_identifier(p,"stringmode");
+      if(octo_map_get(&p->stringmodes,n)==NULL)octo_map_set(&p->stringmodes,n,octo_make_smode());
       octo_smode*s=octo_map_get(&p->stringmodes,n);
-      int text_base=p->source_pos, text_quote=octo_peek_char(p)=='"';
-      char*text=octo_string(p);
-      int splice_index=0;
-      for(int tz=0;tz<octo_interned_len(text);tz++){
-        int c=0xFF&text[tz];
-        if (s->modes[c]==0){
-          p->error_pos=text_base+tz+(text_quote?1:0);
-          p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"String mode '%s' is not defined for the character '%c'.",n,c);
+      int alpha_base=p->source_pos, alpha_quote=octo_peek_char(p)=='"';
+      char*alphabet=octo_string(p);
+      octo_macro*m=octo_make_macro(); // every stringmode needs its own copy of this
+      octo_macro_body(p,"string mode",n,m);
+      char*names[]={octo_intern(p,"CALLS"),octo_intern(p,"CHAR"),octo_intern(p,"INDEX"),octo_intern(p,"VALUE")};
+      octo_macro_slots(m,names,4);
+      for(int z=0;!p->is_error&&z<octo_interned_len(alphabet);z++){
+        int c=0xFF&alphabet[z];
+        if(s->modes[c]!=0){
+          p->error_pos=alpha_base+z+(alpha_quote?1:0);
+          p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"String mode '%s' is already defined for the character '%c'.",n,c);
           break;
         }
-        octo_map bindings; // name -> tok
-        octo_map_init(&bindings);
-        octo_map_set(&bindings,octo_intern(p,"CALLS"),octo_make_tok_num(s->calls++));   // expansion count
-        octo_map_set(&bindings,octo_intern(p,"CHAR" ),octo_make_tok_num(c));            // ascii value of current char
-        octo_map_set(&bindings,octo_intern(p,"INDEX"),octo_make_tok_num((int)tz));      // index of char in input string
-        octo_map_set(&bindings,octo_intern(p,"VALUE"),octo_make_tok_num(s->values[c])); // index of char in class alphabet
-        octo_macro*m=s->modes[c];
-        for(int z=0;z<m->body.count;z++){
-          octo_tok*t=octo_list_get(&m->body,z);
-          octo_tok*r=(t->type==OCTO_TOK_STR)?octo_map_get(&bindings,t->str_value):NULL;
-          octo_list_insert(&p->tokens,octo_tok_copy(r==NULL?t:r),splice_index++);
+        s->values[c]=z;
+        s->modes [c]=octo_make_macro();
+        octo_tok_list_insert(&s->modes[c]->body,&m->body,0);
+      }
+      octo_free_macro(m);
+      break;
+    }
+    default:{
+      octo_tok*t=octo_peek(p);
+      if(p->is_error)return;
+      if(t->type==OCTO_TOK_NUM){
+        int n=t->num_value; octo_free_tok(octo_next(p));
+        if(n<-128||n>255){
+          p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Literal value '%d' does not fit in a byte- must be in range [-128,255].",n);
+        }
+        octo_append(p,n);
+        return;
+      }
+      char*n=t->type==OCTO_TOK_STR?t->str_value:"";
+      if(octo_map_get(&p->macros,n)!=NULL){
+        octo_free_tok(octo_next(p));
+        octo_macro*m=octo_map_get(&p->macros,n);
+        octo_tok calls, **bound=calloc(m->args.count+1,sizeof(octo_tok*));
+        bound[m->args.count]=octo_init_tok_num(&calls,m->calls++);
+        for(int z=0;z<m->args.count;z++){
+          if(octo_is_end(p)){
+            p->error_line=p->source_line, p->error_pos=p->source_pos;
+            p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"Not enough arguments for expansion of macro '%s'.",n);
+            break;
+          }
+          bound[z]=octo_next(p);
         }
-        octo_map_destroy(&bindings,OCTO_DESTRUCTOR(octo_free_tok));
+        octo_macro_expand(p,m,bound);
+        for(int z=0;z<m->args.count;z++)if(bound[z])octo_free_tok(bound[z]);
+        free(bound);
       }
+      else if (octo_map_get(&p->stringmodes,n)!=NULL){
+        octo_free_tok(octo_next(p));
+        octo_smode*s=octo_map_get(&p->stringmodes,n);
+        int text_base=p->source_pos, text_quote=octo_peek_char(p)=='"';
+        char*text=octo_string(p);
+        int len=octo_interned_len(text);
+        for(int tz=0;tz<len;tz++){
+          int c=0xFF&text[tz];
+          if (s->modes[c]==0){
+            p->error_pos=text_base+tz+(text_quote?1:0);
+            p->is_error=1, snprintf(p->error,OCTO_ERR_MAX,"String mode '%s' is not defined for the character '%c'.",n,c);
+            len=tz;
+            break;
+          }
+        }
+        // the stream is reversed, so the last character is expanded first
+        octo_tok values[4], *bound[4];
+        for(int tz=len-1;tz>=0;tz--){
+          int c=0xFF&text[tz];
+          bound[0]=octo_init_tok_num(&values[0],s->calls+tz);  // expansion count
+          bound[1]=octo_init_tok_num(&values[1],c);            // ascii value of current char
+          bound[2]=octo_init_tok_num(&values[2],tz);           // index of char in input string
+          bound[3]=octo_init_tok_num(&values[3],s->values[c]); // index of char in class alphabet
+          octo_macro_expand(p,s->modes[c],bound);
+        }
+        s->calls+=len;
+      }
+      else octo_immediate(p, 0x20, octo_value_12bit(p));
     }
-    else octo_immediate(p, 0x20, octo_value_12bit(p));
   }
 }
 
-octo_program* octo_program_init(char* text){
+octo_program* octo_program_init_buffer(char* text,size_t length,int owned){
+  // tokenize length bytes of text, which need not be NUL-terminated.
+  // if owned, the text is freed along with the program.
   octo_program* p=malloc(sizeof(octo_program));
   p->strings_used=0;
   memset(p->strings,'\0',OCTO_INTERN_MAX);
+  for(int z=1;z<OCTO_KW_COUNT;z++)octo_intern(p,octo_keywords[z].name)[-3]=z;
   p->source=text;
   p->source_root=text;
+  p->source_end=text+length;
+  p->source_owned=owned;
   p->source_line=0;
   p->source_pos=0;
   octo_list_init(&p->tokens);
@@ -1130,6 +1585,8 @@ octo_program* octo_program_init(char* text){
   p->length=OCTO_RAM_MAX;
   memset(p->rom, 0,OCTO_RAM_MAX);
   memset(p->used,0,OCTO_RAM_MAX);
+  memset(p->code,0,OCTO_RAM_MAX);
+  p->pinned=0, p->calc_label=0;
   octo_map_init(&p->constants);
   octo_map_init(&p->aliases);
   octo_map_init(&p->protos);
@@ -1138,13 +1595,22 @@ octo_program* octo_program_init(char* text){
   octo_stack_init(&p->loops);
   octo_stack_init(&p->branches);
   octo_stack_init(&p->whiles);
-  memset(p->breakpoints,0,sizeof(char*)*OCTO_RAM_MAX);
+  memset(p->breakpoints,0,sizeof(p->breakpoints));
+  octo_list_init(&p->breaks);
+  p->labels=NULL, p->label_count=0;
+  memset(p->register_aliases,0,sizeof(p->register_aliases));
   octo_map_init(&p->monitors);
+  octo_list_init(&p->watches);
   p->is_error=0;
   p->error[0]='\0';
   p->error_line=0;
   p->error_pos=0;
-  if((unsigned char)p->source[0]==0xEF&&(unsigned char)p->source[1]==0xBB&&(unsigned char)p->source[2]==0xBF)p->source+=3; // UTF-8 BOM
+  p->error_file=0;
+  p->source_file=0;
+  p->timed=0;
+  octo_list_init(&p->files);
+  octo_list_append(&p->files,calloc(1,sizeof(octo_file)));
+  if(length>=3&&(unsigned char)p->source[0]==0xEF&&(unsigned char)p->source[1]==0xBB&&(unsigned char)p->source[2]==0xBF)p->source+=3; // UTF-8 BOM
   octo_skip_whitespace(p);
 
   #define octo_kc(l,n) (octo_map_set(&p->constants,octo_intern(p,("OCTO_KEY_"l)),octo_make_const(n,0)))
@@ -1157,18 +1623,27 @@ octo_program* octo_program_init(char* text){
   octo_map_set(&p->aliases,octo_intern(p,"unpack-lo"),octo_make_reg(1));
   return p;
 }
+octo_program* octo_program_init(char* text){
+  return octo_program_init_buffer(text,strlen(text),1);
+}
 
-octo_program* octo_compile_str(char* text) {
-  octo_program* p=octo_program_init(text);
+octo_program* octo_compile_program(octo_program* p) {
   octo_instruction(p, 0x00, 0x00); // reserve a jump slot for main
   while(!octo_is_end(p) && !p->is_error){
-    p->error_line=p->source_line;
-    p->error_pos =p->source_pos;
+    // statements spliced in by an :include are found by their tokens
+    octo_tok*t=p->tokens.count?octo_list_get(&p->tokens,p->tokens.count-1):NULL;
+    p->error_file=t?t->file:0;
+    p->error_line=p->error_file?t->line:p->source_line;
+    p->error_pos =p->error_file?t->pos :p->source_pos;
+    if(!p->timed){octo_compile_statement(p);continue;}
+    octo_file*f=octo_list_get(&p->files,p->error_file);
+    clock_t start=clock();
     octo_compile_statement(p);
+    f->seconds+=(clock()-start)/(double)CLOCKS_PER_SEC;
   }
   if(p->is_error)return p;
   while(p->length>0x200&&!p->used[p->length-1])p->length--;
-  p->error_line=p->source_line, p->error_pos=p->source_pos;
+  p->error_line=p->source_line, p->error_pos=p->source_pos, p->error_file=0;
 
   if(p->has_main){
     octo_const*c=octo_map_get(&p->constants,octo_intern(p,"main"));
@@ -1177,23 +1652,30 @@ octo_program* octo_compile_str(char* text) {
   }
   if(p->protos.keys.count>0){
     octo_proto*pr=octo_list_get(&p->protos.values,0);
-    p->error_line=pr->line, p->error_pos=pr->pos;
+    p->error_line=pr->line, p->error_pos=pr->pos, p->error_file=pr->file;
     p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"Undefined forward reference: %s",(char*)octo_list_get(&p->protos.keys,0));
     return p;
   }
   if(!octo_stack_is_empty(&p->loops)){
     octo_flow*f=octo_stack_pop(&p->loops);
     p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This 'loop' does not have a matching 'again'.");
-    p->error_line=f->line, p->error_pos=f->pos;
+    p->error_line=f->line, p->error_pos=f->pos, p->error_file=f->file;
     octo_free_flow(f);
     return p;
   }
   if(!octo_stack_is_empty(&p->branches)){
     octo_flow*f=octo_stack_pop(&p->branches);
     p->is_error=1;snprintf(p->error,OCTO_ERR_MAX,"This '%s' does not have a matching 'end'.",f->type);
-    p->error_line=f->line, p->error_pos=f->pos;
+    p->error_line=f->line, p->error_pos=f->pos, p->error_file=f->file;
     octo_free_flow(f);
     return p;
   }
+  octo_index_program(p);
   return p;
 }
+octo_program* octo_compile_buffer(char* text,size_t length,int owned) {
+  return octo_compile_program(octo_program_init_buffer(text,length,owned));
+}
+octo_program* octo_compile_str(char* text) {
+  return octo_compile_program(octo_program_init(text));
+}
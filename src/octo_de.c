@@ -10,6 +10,7 @@
 #include "octo_emulator.h"
 #include "octo_compiler.h"
 #include "octo_cartridge.h"
+#include "octo_profile.h"
 #include <SDL.h>
 #include "octo_util.h"
 
@@ -198,8 +199,8 @@ void text_categorize(int row){
     char c=line_get(line,col); int n=prev;
     if(prev==TOKEN_NORMAL){
       if(col==0||isspace(line_get(line,col-1))){
-        for(size_t z=0;z<sizeof(octo_reserved_words)/sizeof(char*);z++)if(line_at(line,col,octo_reserved_words[z])){
-          int len=strlen(octo_reserved_words[z]);
+        for(int z=1;z<OCTO_KW_COUNT;z++)if(octo_keywords[z].reserved&&line_at(line,col,octo_keywords[z].name)){
+          int len=strlen(octo_keywords[z].name);
           if(col+len>=line->count||isspace(line_get(line,col+len))){
             for(int kc=0;kc<len;kc++)line_set_cat(line,col++,TOKEN_KEYWORD);
             goto process_row;
@@ -548,8 +549,17 @@ void render_text_editor(void){
   draw_vline(mb.x-1,0,th,WHITE);
   if(widget_menubutton(&mb,NULL,ICON_PLAY,EVENT_RUN)){
     if(prog!=NULL)octo_free_program(prog);
-    prog=octo_compile_str(text_export());
-    if(prog->is_error){
+    char filename[OCTO_PATH_MAX]="\0";
+    octo_path_append(filename,state.open_path);
+    octo_path_append(filename,state.open_name);
+    char*source=text_export();
+    prog=octo_cache_compile(source,strlen(source),1,filename);
+    if(prog->is_error&&octo_error_file(prog)){
+      // the error is in another file, so leave the cursor be
+      snprintf(state.text_status,sizeof(state.text_status),"%s: (%d:%d) %s",octo_error_file(prog),prog->error_line+1,prog->error_pos+1,prog->error);state.text_err=1;
+      octo_free_program(prog);prog=NULL;
+    }
+    else if(prog->is_error){
       text_setcursor(prog->error_pos,prog->error_line);
       text_line*line=octo_list_get(&state.text_lines,state.text_cursor.end.row);
       int c=state.text_cursor.end.col;
@@ -565,6 +575,7 @@ void render_text_editor(void){
     else{
       int bytes=prog->length-0x200;
       octo_emulator_init(&emu,prog->rom+0x200,bytes,&defaults,NULL);
+      emu_watch(&emu,prog);
       snprintf(state.text_status,sizeof(state.text_status),"%d bytes, %d free.",bytes,emu.options.max_rom-bytes);state.text_err=0;
       state.mode=MODE_RUN;
     }
@@ -1414,7 +1425,10 @@ void save_file(void){
     return;
   }
   char*source=text_export();
-  octo_cart_save(file,source,&defaults,NULL,state.open_name);
+  octo_program*p=octo_cache_compile(source,strlen(source),0,filename); // carts carry their rom, if the program compiles without includes
+  if(p->is_error||p->files.count>1)octo_cart_save(file,source,&defaults,NULL,state.open_name,NULL,0);
+  else           octo_cart_save(file,source,&defaults,NULL,state.open_name,(char*)p->rom+0x200,p->length-0x200);
+  octo_free_program(p);
   free(source);
   fclose(file);
   snprintf(state.text_status,sizeof(state.text_status),"Saved octocart '%s'",state.open_name);state.text_err=0;
@@ -1610,6 +1624,7 @@ int main(int argc,char*argv[]){
     if(e.type==SDL_RENDER_DEVICE_RESET||e.type==SDL_RENDER_TARGETS_RESET){
       SDL_DestroyTexture(overlay),overlay=NULL;
       octo_ui_init(win,&ren,&screen);
+      octo_ui_invalidate(&emu);
     }
     events_queue(&e);
     events_joystick(&emu,&joy,&e);
@@ -1642,6 +1657,8 @@ int main(int argc,char*argv[]){
         emu_step(&emu,prog);
         if(input.events[EVENT_ESCAPE])state.mode=MODE_TEXT_EDITOR;
         if(input.events[EVENT_TOGGLE_MONITORS])ui.show_monitors=!ui.show_monitors,octo_ui_invalidate(&emu);
+        if(input.events[EVENT_TOGGLE_PROFILE])ui.show_profile=(ui.show_profile+1)%4,octo_ui_invalidate(&emu);
+        if(input.events[EVENT_TOGGLE_STATS  ])ui.show_stats=!ui.show_stats,octo_ui_invalidate(&emu);
         if(emu.halt){
           if(input.events[EVENT_INTERRUPT])emu.halt=0,octo_ui_invalidate(&emu);
           if(input.events[EVENT_STEP]){
@@ -13,6 +13,11 @@
 #include <stdio.h>  // snprintf()
 #include <stdlib.h> // abs(), rand()
 #include <stdint.h> // uint8_t uint_16t
+#include <stddef.h> // offsetof()
+#if defined(__SSE2__)||defined(_M_X64)
+#define OCTO_SSE2
+#include <emmintrin.h> // palette expansion
+#endif
 
 /**
 *
@@ -266,12 +271,41 @@ char* octo_font_sets[][2]={
 **/
 
 #define OCTO_HALT_MAX 256
+#define OCTO_WATCH_MAX 32
 
 typedef struct {
+  int base, len;         // a range of ram
+  int read;              // halt on reads rather than writes?
+} octo_watchpoint;
+
+typedef struct {
+  long     end;          // tick at which the frame this snapshot was taken in ends
+  long     ticks;        // tick count at the loop head
+  long     writes;       // side effect count at the loop head
+  uint16_t pc, i;
+  uint16_t ret[16];
+  int      rp, plane;
+  uint8_t  v[16], dt, st, pitch;
+} octo_idle;
+
+typedef struct {
+  long instructions;     // ticks executed, including those fast-forwarded
+  long idle;             // ticks fast-forwarded through idle loops
+  long waiting;          // ticks of the budget left unused, waiting for vblank or a key
+  long sprites;          // sprites drawn
+  long pixels;           // pixels toggled by sprites, per plane
+  long collisions;       // sprites which set vF
+  long scrolls;          // scroll instructions
+  long clears;           // display clears, including resolution changes
+} octo_frame_stats;
+
+typedef struct octo_emulator {
   // core
   uint8_t  ram[64*1024]; // memory
   uint8_t  px [128*64];  // framebuffer ({0,1,2,3} per pixel)
-  uint8_t  ppx[128*64];  // previous framebuffer (for minimizing repaints)
+  uint64_t dirty;        // framebuffer rows modified since the last repaint (bitmask)
+  uint64_t pages[4];     // 256-byte ram pages written since init or the last reset (bitmask)
+  uint64_t watched[2][4]; // 256-byte ram pages with write and read watchpoints (bitmask)
   uint16_t ret[16];      // return stack
   int      rp;           // return stack pointer
   uint8_t  v[16];        // v registers
@@ -289,6 +323,15 @@ typedef struct {
   int      had_sound;    // was audio played in the last batch of instructions?
   int      pending;      // a blocking key input, pending debounce
   octo_options options;
+  void   (*exec)(struct octo_emulator*e); // interpreter specialised for the quirks in options
+  long     writes;       // side effects (memory, display, flags, rng) so far
+  uint32_t seed;         // xorshift state for random numbers (0: use rand())
+  struct octo_profile*profile; // optional execution profile (NULL: disabled)
+  struct octo_trace*trace; // optional ring of recently executed instructions (NULL: disabled)
+  octo_frame_stats stats; // drawing counters; the frontend fills in the rest and clears them each frame
+  octo_idle idle;        // machine state at the target of the last backward branch
+  octo_watchpoint watches[OCTO_WATCH_MAX];
+  int      watch_count;
 
   // input
   char wait;
@@ -300,9 +343,10 @@ typedef struct {
   char halt_message[OCTO_HALT_MAX];
 } octo_emulator;
 
+void octo_emulator_specialize(octo_emulator*e);
 void octo_emulator_init(octo_emulator* e, char* rom, size_t romsize, octo_options* options, char* flags){
   memset(e,0,sizeof(octo_emulator));
-  memset(e->ppx,-1,sizeof(e->ppx));
+  e->dirty=-1;
   if (options!=NULL) memcpy(&e->options,options,sizeof(octo_options)); else octo_default_options(&e->options);
   if (flags  !=NULL) memcpy(&e->flags,flags,16);
   e->pc=0x200;
@@ -310,11 +354,29 @@ void octo_emulator_init(octo_emulator* e, char* rom, size_t romsize, octo_option
   e->pending=-1;
   e->pitch=64;
   e->osc=0;
+  octo_emulator_specialize(e);
   memcpy(e->ram+0x200,rom,romsize);
   memcpy(e->ram,     octo_font_sets[e->options.font][0], 5*16);
   memcpy(e->ram+5*16,octo_font_sets[e->options.font][1],10*16);
 }
 
+/**
+*
+*  Snapshots
+*
+*  return an emulator to a snapshot it was copied from (or
+*  last reset to), copying back only the ram pages written
+*  since then along with the framebuffer and registers.
+*
+**/
+
+void octo_emulator_reset(octo_emulator*e,octo_emulator*snapshot){
+  for(int p=0;p<256;p++)if((e->pages[p>>6]>>(p&63))&1)memcpy(e->ram+p*256,snapshot->ram+p*256,256);
+  memcpy(e->px,snapshot->px,sizeof(octo_emulator)-offsetof(octo_emulator,px));
+  memset(e->pages,0,sizeof(e->pages));
+  e->dirty=-1;
+}
+
 /**
 *
 *  Monitors
@@ -356,36 +418,159 @@ void octo_monitor_format(octo_emulator*e, int is_register,int base,int len,char*
   dest[d]='\0';
 }
 
+// the interpreter is stamped out into one variant per combination of
+// quirks flags (and tracing): the helpers take the flags as arguments and
+// are forced inline, so each variant folds its tests away.
+#if defined(_MSC_VER)
+#define OCTO_INLINE static __forceinline
+#elif defined(__GNUC__)
+#define OCTO_INLINE static inline __attribute__((always_inline))
+#else
+#define OCTO_INLINE static inline
+#endif
+
+/**
+*
+*  Tracing
+*
+*  a trace keeps the pc and opcode of each of the last
+*  OCTO_TRACE_SIZE instructions in a ring of 32-bit words,
+*  and every OCTO_TRACE_MARK instructions (and whenever it
+*  is attached) marks the registers as they stood. i, vX
+*  and vF are not recorded, but rebuilt when the trace is
+*  saved by replaying the instructions since a mark; see
+*  octo_trace.h. a program which halts unexpectedly can
+*  then be examined after the fact. attaching a trace swaps
+*  in interpreters which record the opcode they have already
+*  fetched, so a traced instruction costs a counter, a store
+*  and an untaken branch, and an untraced one nothing. the
+*  ring is kept small enough to stay in cache: in a tight
+*  arithmetic loop tracing costs the interpreter 5-9%, and
+*  in one which draws, 1-5%.
+*
+**/
+
+#define OCTO_TRACE_SIZE  8192 // a power of two
+#define OCTO_TRACE_MARK  4096 // a power of two
+#define OCTO_TRACE_MARKS (OCTO_TRACE_SIZE/OCTO_TRACE_MARK)
+
+typedef struct {
+  uint64_t count;  // instructions traced before this mark
+  uint32_t seed;
+  uint16_t i;
+  uint8_t  v[16], flags[16];
+} octo_trace_mark;
+
+typedef struct octo_trace {
+  uint32_t ring[OCTO_TRACE_SIZE]; // pc<<16|op; the newest is ring[(count-1)%OCTO_TRACE_SIZE]
+  uint64_t count;                 // instructions traced
+  octo_trace_mark marks[OCTO_TRACE_MARKS]; // at each multiple of OCTO_TRACE_MARK, by (count/OCTO_TRACE_MARK)%OCTO_TRACE_MARKS
+  octo_trace_mark attached;       // when the trace was last attached, as nothing before it can be replayed
+} octo_trace;
+
+void octo_emulator_mark(octo_emulator*e,octo_trace_mark*m,uint64_t count){
+  m->count=count, m->seed=e->seed, m->i=e->i;
+  memcpy(m->v,e->v,sizeof(m->v)), memcpy(m->flags,e->flags,sizeof(m->flags));
+}
+void octo_emulator_trace(octo_emulator*e,octo_trace*t){
+  e->trace=t;
+  if(t)octo_emulator_mark(e,&t->attached,t->count);
+  octo_emulator_specialize(e);
+}
+OCTO_INLINE void octo_emulator_traced(octo_emulator*e,uint16_t pc,uint16_t op){
+  octo_trace*t=e->trace;
+  uint64_t n=t->count++;
+  if(!(n&(OCTO_TRACE_MARK-1)))octo_emulator_mark(e,&t->marks[(n/OCTO_TRACE_MARK)%OCTO_TRACE_MARKS],n);
+  t->ring[n&(OCTO_TRACE_SIZE-1)]=((uint32_t)pc<<16)|op;
+}
+
 /**
 *
 *  Core Emulation
 *
 **/
 
-uint8_t octo_get(octo_emulator*e,uint8_t offset){return e->ram[e->i+offset];}
-void octo_set(octo_emulator*e,uint8_t offset,uint8_t value){e->ram[e->i+offset]=value;}
+uint8_t octo_emulator_random(octo_emulator*e){
+  if(e->seed==0)return rand();
+  e->seed^=e->seed<<13, e->seed^=e->seed>>17, e->seed^=e->seed<<5;
+  return e->seed>>24;
+}
+/**
+*
+*  Watchpoints
+*
+*  halt when a range of ram is written or read. each access
+*  through octo_set or octo_get tests one bit of a bitmap of
+*  watched 256-byte pages, and only accesses to a watched
+*  page search the table of ranges, so an unwatched program
+*  pays for a single untaken branch.
+*
+**/
+
+int octo_emulator_watch(octo_emulator*e,int base,int len,int read){
+  // returns 0 if the table of watchpoints is full
+  if(len<=0)return 1;
+  if(e->watch_count>=OCTO_WATCH_MAX)return 0;
+  octo_watchpoint*w=&e->watches[e->watch_count++];
+  w->base=base, w->len=len, w->read=!!read;
+  for(int p=base>>8;p<=(base+len-1)>>8;p++)e->watched[w->read][(p>>6)&3]|=1ull<<(p&63);
+  return 1;
+}
+void octo_emulator_unwatch(octo_emulator*e){
+  e->watch_count=0, memset(e->watched,0,sizeof(e->watched));
+}
+int octo_emulator_watching(octo_emulator*e,int read){
+  uint64_t*w=e->watched[read];
+  return (w[0]|w[1]|w[2]|w[3])!=0;
+}
+void octo_emulator_watched(octo_emulator*e,int a,int read,uint8_t value){
+  // called for accesses to a watched page. only the first hit of an instruction is reported
+  if(e->halt)return;
+  for(int z=0;z<e->watch_count;z++){
+    octo_watchpoint*w=&e->watches[z];
+    if(w->read!=read||a<w->base||a>=w->base+w->len)continue;
+    e->halt=1;
+    if(read)snprintf(e->halt_message,OCTO_HALT_MAX,"Read from watched 0x%04X",a);
+    else    snprintf(e->halt_message,OCTO_HALT_MAX,"Write 0x%02X to watched 0x%04X",value,a);
+    return;
+  }
+}
+#define OCTO_WATCHED(e,read,a) (((e)->watched[read][((a)>>14)&3]>>(((a)>>8)&63))&1)
+
+uint8_t octo_get(octo_emulator*e,uint8_t offset){
+  int a=e->i+offset;
+  if(OCTO_WATCHED(e,1,a))octo_emulator_watched(e,a,1,0);
+  return e->ram[a];
+}
+void octo_set(octo_emulator*e,uint8_t offset,uint8_t value){
+  int a=e->i+offset;
+  e->ram[a]=value, e->writes++, e->pages[(a>>14)&3]|=1ull<<((a>>8)&63);
+  if(OCTO_WATCHED(e,0,a))octo_emulator_watched(e,a,0,value);
+}
 uint16_t octo_emulator_word(octo_emulator*e){uint16_t r=(e->ram[e->pc]<<8)|e->ram[e->pc+1];return e->pc+=2, r;}
 void octo_emulator_skip(octo_emulator*e){uint16_t r=(e->ram[e->pc]<<8)|e->ram[e->pc+1];e->pc+=r==0xF000?4:2;}
 void octo_emulator_carry(octo_emulator*e,int dest,uint8_t value,char flag){e->v[dest]=value, e->v[0xF]=flag&1;}
-void octo_emulator_math(octo_emulator*e,int x,int y,int op){
+
+OCTO_INLINE void octo_emulator_math_q(octo_emulator*e,int x,int y,int op,int q_logic,int q_shift){
   int t;
   switch(op){
-    case 0x0: e->v[x] =e->v[y];                                                               break;
-    case 0x1: e->v[x]|=e->v[y]; if(e->options.q_logic)e->v[0xF]=0;                            break;
-    case 0x2: e->v[x]&=e->v[y]; if(e->options.q_logic)e->v[0xF]=0;                            break;
-    case 0x3: e->v[x]^=e->v[y]; if(e->options.q_logic)e->v[0xF]=0;                            break;
-    case 0x4: t=e->v[x]+e->v[y], octo_emulator_carry(e,x,t,t>0xFF);                           break;
-    case 0x5: t=e->v[x]-e->v[y], octo_emulator_carry(e,x,t,e->v[x]>=e->v[y]);                 break;
-    case 0x7: t=e->v[y]-e->v[x], octo_emulator_carry(e,x,t,e->v[y]>=e->v[x]);                 break;
-    case 0x6: if(e->options.q_shift)y=x; t=e->v[y]>>1, octo_emulator_carry(e,x,t,e->v[y]&1);  break;
-    case 0xE: if(e->options.q_shift)y=x; t=e->v[y]<<1, octo_emulator_carry(e,x,t,e->v[y]>>7); break;
+    case 0x0: e->v[x] =e->v[y];                                                      break;
+    case 0x1: e->v[x]|=e->v[y]; if(q_logic)e->v[0xF]=0;                              break;
+    case 0x2: e->v[x]&=e->v[y]; if(q_logic)e->v[0xF]=0;                              break;
+    case 0x3: e->v[x]^=e->v[y]; if(q_logic)e->v[0xF]=0;                              break;
+    case 0x4: t=e->v[x]+e->v[y], octo_emulator_carry(e,x,t,t>0xFF);                  break;
+    case 0x5: t=e->v[x]-e->v[y], octo_emulator_carry(e,x,t,e->v[x]>=e->v[y]);        break;
+    case 0x7: t=e->v[y]-e->v[x], octo_emulator_carry(e,x,t,e->v[y]>=e->v[x]);        break;
+    case 0x6: if(q_shift)y=x; t=e->v[y]>>1, octo_emulator_carry(e,x,t,e->v[y]&1);    break;
+    case 0xE: if(q_shift)y=x; t=e->v[y]<<1, octo_emulator_carry(e,x,t,e->v[y]>>7);   break;
     default: e->halt=1, snprintf(e->halt_message,OCTO_HALT_MAX,"Unknown Math Opcode 0x8%X%X%0X",x,y,op);
   }
 }
-void octo_emulator_misc(octo_emulator*e, int x, int op){
+void octo_emulator_math(octo_emulator*e,int x,int y,int op){octo_emulator_math_q(e,x,y,op,e->options.q_logic,e->options.q_shift);}
+OCTO_INLINE void octo_emulator_misc_q(octo_emulator*e, int x, int op, int q_loadstore){
   switch(op){
     case 0x01: e->plane=x&3;                                                                          break;
-    case 0x02: for(int z=0;z<16;z++)e->pattern[z]=octo_get(e,z);                                      break;
+    case 0x02: for(int z=0;z<16;z++)e->pattern[z]=octo_get(e,z); e->writes++;                         break;
     case 0x07: e->v[x]=e->dt;                                                                         break;
     case 0x0A: e->wait=1, e->wait_reg=x;                                                              break;
     case 0x15: e->dt=e->v[x];                                                                         break;
@@ -395,13 +580,14 @@ void octo_emulator_misc(octo_emulator*e, int x, int op){
     case 0x30: e->i=10*(e->v[x]&0xF)+(5*16);                                                          break;
     case 0x33: octo_set(e,0,(e->v[x]/100)%10),octo_set(e,1,(e->v[x]/10)%10),octo_set(e,2,e->v[x]%10); break;
     case 0x3A: e->pitch=e->v[x];                                                                      break;
-    case 0x55: for(int z=0;z<=x;z++)octo_set(e,z,e->v[z]); if(!e->options.q_loadstore)e->i+=x+1;      break;
-    case 0x65: for(int z=0;z<=x;z++)e->v[z]=octo_get(e,z); if(!e->options.q_loadstore)e->i+=x+1;      break;
-    case 0x75: for(int z=0;z<=(0xF&x);z++)e->flags[z]=e->v[z];                                        break;
+    case 0x55: for(int z=0;z<=x;z++)octo_set(e,z,e->v[z]); if(!q_loadstore)e->i+=x+1;                 break;
+    case 0x65: for(int z=0;z<=x;z++)e->v[z]=octo_get(e,z); if(!q_loadstore)e->i+=x+1;                 break;
+    case 0x75: for(int z=0;z<=(0xF&x);z++)e->flags[z]=e->v[z]; e->writes++;                           break;
     case 0x85: for(int z=0;z<=(0xF&x);z++)e->v[z]=e->flags[z];                                        break;
     default: e->halt=1, snprintf(e->halt_message,OCTO_HALT_MAX,"Unknown Misc Opcode 0xF%X%0X",x,op);
   }
 }
+void octo_emulator_misc(octo_emulator*e, int x, int op){octo_emulator_misc_q(e,x,op,e->options.q_loadstore);}
 uint8_t* octo_emulator_pix(octo_emulator*e,int x,int y){
   return e->px + (e->hires? ((y&63)*128)+(x&127): ((y&31)* 64)+(x& 63));
 }
@@ -411,20 +597,32 @@ void octo_emulator_draw(octo_emulator*e,int x,int y,int color){
   if((color&*p)==0) (*p)|=color; // set   pixel
   else(*p)&=~color, e->v[0xF]=1; // clear pixel
 }
-void octo_emulator_sprite(octo_emulator*e, int x, int y, int len){
-  e->v[0xF]=0;
+OCTO_INLINE void octo_emulator_sprite_q(octo_emulator*e, int x, int y, int len, int q_clip){
+  e->v[0xF]=0, e->writes++;
   int i=e->i, row=e->hires?128:64, col=e->hires?64:32, xd=len==0?16:8, yd=len==0?16:len;
+  int xc=xd, yc=yd; // with clipping, stop at the edges of the display instead of wrapping
+  int bytes=(len==0?32:len)*((e->plane&1)+((e->plane>>1)&1)); // at most two pages
+  if(bytes&&(OCTO_WATCHED(e,1,i)||OCTO_WATCHED(e,1,i+bytes-1)))for(int z=0;z<bytes;z++)octo_emulator_watched(e,i+z,1,0);
+  if(q_clip){if(xc>row-(x%row))xc=row-(x%row); if(yc>col-(y%col))yc=col-(y%col);}
   for(int color=1;color<=2;color++){
     if(!(e->plane&color))continue;
-    for(int a=0;a<yd;a++)for(int b=0;b<xd;b++){
-      int c=len==0?(e->ram[i+(2*a)+(b>7?1:0)]>>(7-(b%8)))&1:
-                   (e->ram[i+   a           ]>>(7- b   ))&1;
-      if(e->options.q_clip) if((x%row)+b>=row||(y%col)+a>=col) c=0;
-      octo_emulator_draw(e,b+x,a+y,c?color:0);
+    for(int a=0;a<yc;a++){
+      uint8_t*r=e->px+(((y+a)&(col-1))*row);
+      int bits=len==0?(e->ram[i+(2*a)]<<8)|e->ram[i+(2*a)+1]: e->ram[i+a]<<8;
+      for(int b=0;b<xc;b++){
+        if(!((bits>>(15-b))&1))continue;
+        uint8_t*p=r+((x+b)&(row-1));
+        if((color&*p)==0) (*p)|=color; // set   pixel
+        else(*p)&=~color, e->v[0xF]=1; // clear pixel
+        e->stats.pixels++;
+      }
     }
     i+=len==0?32:len;
   }
+  for(int a=0;a<yd;a++)e->dirty|=1ull<<((y+a)&(col-1));
+  e->stats.sprites++, e->stats.collisions+=e->v[0xF];
 }
+void octo_emulator_sprite(octo_emulator*e, int x, int y, int len){octo_emulator_sprite_q(e,x,y,len,e->options.q_clip);}
 void octo_emulator_move_pix(octo_emulator*e,int dx,int dy,int sx,int sy){
   for(int color=1;color<=2;color++)if(e->plane&color){
     uint8_t *d=octo_emulator_pix(e,dx,dy), *s=octo_emulator_pix(e,sx,sy);
@@ -433,25 +631,26 @@ void octo_emulator_move_pix(octo_emulator*e,int dx,int dy,int sx,int sy){
     (*d)|=c;      // add new pixel
   }
 }
-void octo_emulator_instruction(octo_emulator*e){
+OCTO_INLINE void octo_emulator_exec(octo_emulator*e,int q_shift,int q_loadstore,int q_jump0,int q_logic,int q_clip,int traced){
   if(e->wait)return;
   e->ticks++;
   uint16_t op=octo_emulator_word(e), x=(op>>8)&0xF, y=(op>>4)&0xF;
+  if(traced)octo_emulator_traced(e,e->pc-2,op);
   uint16_t o=(op>>12)&0xF, nnn=0xFFF&op, nn=0xFF&op, n=0xF&op, row=e->hires?128:64, col=e->hires?64:32;
-  if(op==0x00E0){for(size_t z=0;z<sizeof(e->px);z++)e->px[z]&=~e->plane;                                     return;}
+  if(op==0x00E0){for(size_t z=0;z<sizeof(e->px);z++)e->px[z]&=~e->plane; e->dirty=-1, e->writes++, e->stats.clears++;return;}
   if(op==0x00EE){e->pc=e->ret[--(e->rp)];                                                                    return;}
   if(op==0x00FD){e->halt=1, e->halt_message[0]='\0';                                                         return;}
-  if(op==0x00FE){e->hires=0, memset(e->px,0,sizeof(e->px));                                                  return;}
-  if(op==0x00FF){e->hires=1, memset(e->px,0,sizeof(e->px));                                                  return;}
+  if(op==0x00FE){e->hires=0, memset(e->px,0,sizeof(e->px)), e->dirty=-1, e->writes++, e->stats.clears++;     return;}
+  if(op==0x00FF){e->hires=1, memset(e->px,0,sizeof(e->px)), e->dirty=-1, e->writes++, e->stats.clears++;     return;}
   if(op==0xF000){e->i=octo_emulator_word(e);                                                                 return;}
   if((op&0xF0FF)==0xE09E){if(e->v[x]<=15&& e->keys[e->v[x]]) octo_emulator_skip(e);                          return;}
   if((op&0xF0FF)==0xE0A1){if(e->v[x] >15||!e->keys[e->v[x]]) octo_emulator_skip(e);                          return;}
   if((op&0xF00F)==0x5002){for(int z=0;z<=abs(x-y);z++) octo_set(e,z,e->v[x<y?x+z:x-z]);                      return;}
   if((op&0xF00F)==0x5003){for(int z=0;z<=abs(x-y);z++) e->v[x<y?x+z:x-z]=octo_get(e,z);                      return;}
-  if((op&0xFFF0)==0x00C0){for(int y=col-1;y>=0;y--)for(int x=0;x<row;x++)octo_emulator_move_pix(e,x,y,x,y-n);return;} // scroll down
-  if((op&0xFFF0)==0x00D0){for(int y=0;y<col;y++)for(int x=0;x<row;x++)   octo_emulator_move_pix(e,x,y,x,y+n);return;} // scroll up
-  if(op==0x00FB)         {for(int y=0;y<col;y++)for(int x=row-1;x>=0;x--)octo_emulator_move_pix(e,x,y,x-4,y);return;} // scroll right
-  if(op==0x00FC)         {for(int y=0;y<col;y++)for(int x=0;x<row;x++)   octo_emulator_move_pix(e,x,y,x+4,y);return;} // scroll left
+  if((op&0xFFF0)==0x00C0){for(int y=col-1;y>=0;y--)for(int x=0;x<row;x++)octo_emulator_move_pix(e,x,y,x,y-n);e->dirty=-1,e->writes++,e->stats.scrolls++;return;} // scroll down
+  if((op&0xFFF0)==0x00D0){for(int y=0;y<col;y++)for(int x=0;x<row;x++)   octo_emulator_move_pix(e,x,y,x,y+n);e->dirty=-1,e->writes++,e->stats.scrolls++;return;} // scroll up
+  if(op==0x00FB)         {for(int y=0;y<col;y++)for(int x=row-1;x>=0;x--)octo_emulator_move_pix(e,x,y,x-4,y);e->dirty=-1,e->writes++,e->stats.scrolls++;return;} // scroll right
+  if(op==0x00FC)         {for(int y=0;y<col;y++)for(int x=0;x<row;x++)   octo_emulator_move_pix(e,x,y,x+4,y);e->dirty=-1,e->writes++,e->stats.scrolls++;return;} // scroll left
   switch(o){
     case 0x0: e->halt=1, e->halt_message[0]='\0';                break;
     case 0x1: e->pc=nnn;                                         break;
@@ -461,14 +660,195 @@ void octo_emulator_instruction(octo_emulator*e){
     case 0x5: if(e->v[x]==e->v[y]) octo_emulator_skip(e);        break;
     case 0x6: e->v[x]=nn;                                        break;
     case 0x7: e->v[x]+=nn;                                       break;
-    case 0x8: octo_emulator_math(e,x,y,n);                       break;
+    case 0x8: octo_emulator_math_q(e,x,y,n,q_logic,q_shift);     break;
     case 0x9: if(e->v[x]!=e->v[y]) octo_emulator_skip(e);        break;
     case 0xA: e->i=nnn;                                          break;
-    case 0xB: e->pc=nnn+e->v[e->options.q_jump0?(nnn>>8)&0xF:0]; break;
-    case 0xC: e->v[x]=rand()&nn;                                 break;
-    case 0xD: octo_emulator_sprite(e,e->v[x],e->v[y],n);         break;
-    case 0xF: octo_emulator_misc(e,x,nn);                        break;
+    case 0xB: e->pc=nnn+e->v[q_jump0?(nnn>>8)&0xF:0];            break;
+    case 0xC: e->v[x]=octo_emulator_random(e)&nn, e->writes++;   break;
+    case 0xD: octo_emulator_sprite_q(e,e->v[x],e->v[y],n,q_clip);break;
+    case 0xF: octo_emulator_misc_q(e,x,nn,q_loadstore);          break;
     default: e->halt=1, snprintf(e->halt_message,OCTO_HALT_MAX,"Unknown Opcode 0x%0X",op);  
   }
   if(e->rp>12){e->halt=1;snprintf(e->halt_message,OCTO_HALT_MAX,"Call Stack Overflow");}
 }
+
+
+#define OCTO_VARIANTS(m) \
+  m( 0) m( 1) m( 2) m( 3) m( 4) m( 5) m( 6) m( 7) m( 8) m( 9) m(10) m(11) m(12) m(13) m(14) m(15) \
+  m(16) m(17) m(18) m(19) m(20) m(21) m(22) m(23) m(24) m(25) m(26) m(27) m(28) m(29) m(30) m(31) \
+  m(32) m(33) m(34) m(35) m(36) m(37) m(38) m(39) m(40) m(41) m(42) m(43) m(44) m(45) m(46) m(47) \
+  m(48) m(49) m(50) m(51) m(52) m(53) m(54) m(55) m(56) m(57) m(58) m(59) m(60) m(61) m(62) m(63)
+#define OCTO_VARIANT(q) void octo_emulator_exec_##q(octo_emulator*e){octo_emulator_exec(e,(q)&1,((q)>>1)&1,((q)>>2)&1,((q)>>3)&1,((q)>>4)&1,((q)>>5)&1);}
+#define OCTO_VARIANT_REF(q) octo_emulator_exec_##q,
+OCTO_VARIANTS(OCTO_VARIANT)
+void (*octo_emulator_variants[64])(octo_emulator*e)={OCTO_VARIANTS(OCTO_VARIANT_REF)};
+void octo_emulator_instruction(octo_emulator*e){e->exec(e);}
+
+/**
+*
+*  Profiling
+*
+*  a profile counts executions and cycles per address,
+*  executions per opcode class, and cycles per call stack.
+*  ticks fast-forwarded through an idle loop are charged
+*  to the branch which closes the loop. a shadow of the
+*  return stack records when each subroutine was entered,
+*  so every 00EE can charge inclusive and exclusive ticks
+*  to the subroutine returning. attaching a profile
+*  swaps in an instrumented interpreter, so there is no
+*  cost when profiling is disabled.
+*
+**/
+
+#define OCTO_PROFILE_STACKS (16*1024)
+#define OCTO_PROFILE_DEPTH  17 // return addresses, then pc
+
+typedef struct {
+  int      depth;
+  uint16_t addr[OCTO_PROFILE_DEPTH];
+  uint64_t cycles;
+} octo_profile_stack;
+
+typedef struct octo_profile {
+  void   (*exec)(octo_emulator*e);   // the uninstrumented interpreter
+  uint32_t count [64*1024];          // executions per address
+  uint64_t cycles[64*1024];          // cycles per address
+  uint64_t classes[16];              // executions per opcode class (high nibble)
+  octo_profile_stack stacks[OCTO_PROFILE_STACKS];
+  uint64_t dropped;                  // cycles in stacks which did not fit the table
+  uint32_t calls    [4*1024];        // calls per subroutine (12-bit address)
+  uint64_t inclusive[4*1024];        // ticks per subroutine, including its callees
+  uint64_t exclusive[4*1024];        // ticks per subroutine, excluding its callees
+  uint16_t target[16];               // subroutine entered at each depth of the return stack
+  long     entry [16];               // tick count when it was entered
+  long     nested[16];               // ticks it has spent in callees which returned
+} octo_profile;
+
+void octo_profile_cycles(octo_profile*p,octo_emulator*e,int pc,int rp,uint64_t cycles){
+  p->cycles[pc]+=cycles;
+  uint32_t h=2166136261u;
+  for(int z=0;z<rp;z++)h=(h^e->ret[z])*16777619u;
+  h=(h^pc)*16777619u;
+  for(int probe=0;probe<64;probe++){
+    octo_profile_stack*s=&p->stacks[(h+probe)%OCTO_PROFILE_STACKS];
+    if(s->depth==0){
+      s->depth=rp+1, memcpy(s->addr,e->ret,rp*sizeof(uint16_t)), s->addr[rp]=pc;
+    }
+    else if(s->depth!=rp+1||s->addr[rp]!=pc||memcmp(s->addr,e->ret,rp*sizeof(uint16_t)))continue;
+    s->cycles+=cycles;
+    return;
+  }
+  p->dropped+=cycles;
+}
+
+void octo_profile_return(octo_profile*p,int d,long ticks){
+  long inclusive=ticks-p->entry[d];
+  p->inclusive[p->target[d]]+=inclusive;
+  p->exclusive[p->target[d]]+=inclusive-p->nested[d];
+  if(d>0)p->nested[d-1]+=inclusive;
+}
+
+void octo_emulator_exec_profiled(octo_emulator*e){
+  octo_profile*p=e->profile;
+  int pc=e->pc, rp=e->rp, op=e->ram[pc]>>4;
+  long t=e->ticks;
+  p->exec(e);
+  if(e->ticks==t)return; // waiting for a key
+  p->count[pc]++, p->classes[op]++;
+  octo_profile_cycles(p,e,pc,rp,1); // calls and returns leave ret[0..rp) as it was
+  if(e->rp>rp&&rp<16)p->target[rp]=e->pc&0xFFF, p->entry[rp]=e->ticks, p->nested[rp]=0, p->calls[e->pc&0xFFF]++;
+  if(e->rp<rp&&e->rp>=0)octo_profile_return(p,e->rp,e->ticks);
+}
+
+void octo_emulator_specialize(octo_emulator*e){
+  octo_options*o=&e->options;
+  e->exec=octo_emulator_variants[(!!o->q_shift)|(!!o->q_loadstore<<1)|(!!o->q_jump0<<2)|(!!o->q_logic<<3)|(!!o->q_clip<<4)|((e->trace!=NULL)<<5)];
+  if(e->profile)e->profile->exec=e->exec, e->exec=octo_emulator_exec_profiled;
+}
+void octo_emulator_profile(octo_emulator*e,octo_profile*p){
+  // subroutines already on the stack are charged from now on
+  e->profile=p;
+  if(p)for(int d=0;d<e->rp&&d<16;d++){
+    uint16_t a=e->ret[d]-2;
+    p->target[d]=((e->ram[a]&0xF)<<8)|e->ram[(uint16_t)(a+1)], p->entry[d]=e->ticks, p->nested[d]=0;
+  }
+  octo_emulator_specialize(e);
+}
+
+/**
+*
+*  Idle Loops
+*
+*  call after executing the instruction at 'from', with the
+*  number of ticks left in this frame. when a backward branch
+*  returns to the head of a loop in exactly the state it had
+*  on the previous visit, with no side effects in between,
+*  every further iteration this frame will do the same, since
+*  dt and the keys only change between frames. skip whole
+*  iterations and return the number of ticks skipped.
+*
+**/
+
+int octo_emulator_idle(octo_emulator*e,int from,int budget){
+  if(e->pc>from||e->halt||e->wait||budget<=0)return 0;
+  octo_idle*s=&e->idle;
+  if(s->end==e->ticks+budget&&s->pc==e->pc&&s->writes==e->writes&&s->i==e->i&&s->rp==e->rp&&
+     s->dt==e->dt&&s->st==e->st&&s->plane==e->plane&&s->pitch==e->pitch&&
+     !memcmp(s->v,e->v,sizeof(e->v))&&!memcmp(s->ret,e->ret,e->rp*sizeof(e->ret[0]))){
+    long len=e->ticks-s->ticks, skip=budget/len*len;
+    e->ticks+=skip, s->ticks=e->ticks, s->end=e->ticks+budget-skip;
+    if(e->profile&&skip)octo_profile_cycles(e->profile,e,from,e->rp,skip);
+    return skip;
+  }
+  s->end=e->ticks+budget, s->ticks=e->ticks, s->writes=e->writes, s->pc=e->pc, s->i=e->i, s->rp=e->rp;
+  s->dt=e->dt, s->st=e->st, s->plane=e->plane, s->pitch=e->pitch;
+  memcpy(s->v,e->v,sizeof(e->v)), memcpy(s->ret,e->ret,sizeof(e->ret));
+  return 0;
+}
+
+/**
+*
+*  Rendering
+*
+*  expand a span of framebuffer rows into ARGB pixels,
+*  applying the palette and display rotation. the result
+*  is a packed rectangle of the rotated display, suitable
+*  for a partial texture upload or a full-frame export.
+*
+**/
+
+void octo_render_palette(int*dest,uint8_t*src,int len,int*colors){
+  int z=0;
+  #ifdef OCTO_SSE2
+  __m128i k=_mm_setzero_si128(), c[4], s[4];
+  for(int i=0;i<4;i++)c[i]=_mm_set1_epi32(colors[i]),s[i]=_mm_set1_epi32(i);
+  for(;z+16<=len;z+=16){
+    __m128i p=_mm_loadu_si128((__m128i*)(src+z)), lo=_mm_unpacklo_epi8(p,k), hi=_mm_unpackhi_epi8(p,k);
+    __m128i q[4]={_mm_unpacklo_epi16(lo,k),_mm_unpackhi_epi16(lo,k),_mm_unpacklo_epi16(hi,k),_mm_unpackhi_epi16(hi,k)};
+    for(int i=0;i<4;i++){
+      __m128i r=_mm_and_si128(_mm_cmpeq_epi32(q[i],s[0]),c[0]);
+      r=_mm_or_si128(r,_mm_and_si128(_mm_cmpeq_epi32(q[i],s[1]),c[1]));
+      r=_mm_or_si128(r,_mm_and_si128(_mm_cmpeq_epi32(q[i],s[2]),c[2]));
+      r=_mm_or_si128(r,_mm_and_si128(_mm_cmpeq_epi32(q[i],s[3]),c[3]));
+      _mm_storeu_si128((__m128i*)(dest+z+4*i),r);
+    }
+  }
+  #endif
+  for(;z<len;z++)dest[z]=colors[src[z]];
+}
+void octo_render(octo_emulator*e,int y0,int y1,int*dest,int*rect){
+  int w=e->hires?128:64, h=e->hires?64:32, n=y1-y0, r=e->options.rotation, t[8][128];
+  rect[0]=r==90?h-y1: r==270?y0:0, rect[2]=r==90||r==270?n:w;
+  rect[1]=r==180?h-y1: r==0?y0:0,  rect[3]=r==90||r==270?w:n;
+  if(r==0)for(int y=y0;y<y1;y++)octo_render_palette(dest+(y-y0)*w,e->px+(y*w),w,e->options.colors);
+  if(r==180)for(int y=y0;y<y1;y++){
+    int*d=dest+(y1-1-y)*w; octo_render_palette(t[0],e->px+(y*w),w,e->options.colors);
+    for(int x=0;x<w;x++)d[w-1-x]=t[0][x];
+  }
+  if(r==90||r==270)for(int b=y0;b<y1;b+=8){ // transpose in bands of 8 rows
+    int m=y1-b<8?y1-b:8;
+    for(int y=0;y<m;y++)octo_render_palette(t[y],e->px+((b+y)*w),w,e->options.colors);
+    if(r==90 )for(int x=0;x<w;x++){int*d=dest+(x*n)+(y1-1-b);      for(int y=0;y<m;y++)d[-y]=t[y][x];}
+    if(r==270)for(int x=0;x<w;x++){int*d=dest+((w-1-x)*n)+(b-y0); for(int y=0;y<m;y++)d[ y]=t[y][x];}
+  }
+}
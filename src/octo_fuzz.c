@@ -0,0 +1,307 @@
+/**
+*
+*  Octo Fuzz
+*
+*  A headless, coverage-guided fuzzer for CHIP-8 programs.
+*  Mutated key schedules are played into a batch of
+*  emulators; schedules which execute new addresses join
+*  the corpus, and schedules which halt the program with
+*  an error are minimized and saved as replayable traces.
+*
+**/
+
+#include "octo_compiler.h"
+#include "octo_emulator.h"
+#include "octo_cartridge.h"
+#include "octo_batch.h"
+#if !defined(_WIN32)
+#include <unistd.h> // sysconf()
+#endif
+
+#define CORPUS_MAX  4096
+#define CRASHES_MAX 256
+#define REPLAY_MAX  2000 // replays spent minimizing each crash
+
+typedef struct {
+  octo_batch*batch;
+  octo_emulator*scratch;     // for replaying a single schedule
+  int frames;                // length of every key schedule
+  int lo, hi;                // memory the program may write to
+  uint16_t*sched;            // current schedule of each instance
+  uint32_t*seeds;            // random seed of each instance
+  uint16_t*corpus[CORPUS_MAX];
+  int corpus_size;
+  uint8_t cover[OCTO_BATCH_COVER];
+  char*crashes[CRASHES_MAX]; // message and pc of every crash saved so far
+  int crash_count;
+  int saved;                 // traces written
+  char*out;                  // directory for traces
+  uint32_t rng;
+} fuzzer;
+
+uint32_t rnd(fuzzer*f){
+  f->rng^=f->rng<<13, f->rng^=f->rng>>17, f->rng^=f->rng<<5;
+  return f->rng;
+}
+
+/**
+*
+*  Execution
+*
+**/
+
+void check_writes(fuzzer*f,octo_emulator*e){
+  // halt if a ram page entirely outside [lo,hi) has been written
+  if(e->halt)return;
+  for(int p=0;p<256;p++)if(((e->pages[p>>6]>>(p&63))&1)&&((p+1)*256<=f->lo||p*256>=f->hi)){
+    e->halt=1;
+    snprintf(e->halt_message,OCTO_HALT_MAX,"Write to 0x%04X-0x%04X",p*256,p*256+255);
+    return;
+  }
+}
+
+void apply_keys(octo_emulator*e,uint16_t mask){
+  for(int k=0;k<16;k++)e->keys[k]=(mask>>k)&1;
+}
+
+void fuzz_input(octo_emulator*e,int index,int frame,void*user){
+  fuzzer*f=user;
+  check_writes(f,e);
+  if(!e->halt)apply_keys(e,f->sched[index*f->frames+frame]);
+}
+
+int replay(fuzzer*f,uint16_t*s,int frames,uint32_t seed){
+  // returns the frame in which the program halted, or -1
+  octo_emulator*e=f->scratch;
+  octo_emulator_reset(e,&f->batch->model);
+  e->seed=seed;
+  for(int t=0;t<frames;t++){
+    apply_keys(e,s[t]);
+    octo_batch_frame(e,NULL);
+    check_writes(f,e);
+    if(e->halt)return t;
+  }
+  return -1;
+}
+
+/**
+*
+*  Mutation
+*
+**/
+
+void mutate(fuzzer*f,uint16_t*s){
+  for(int n=1+rnd(f)%4;n>0;n--){
+    int a=rnd(f)%f->frames, len=1+rnd(f)%(f->frames/8+1);
+    if(a+len>f->frames)len=f->frames-a;
+    switch(rnd(f)%4){
+      case 0: {uint16_t m=rnd(f)%3?1<<(rnd(f)%16):0; for(int t=a;t<a+len;t++)s[t]=m; break;} // hold a key
+      case 1: {uint16_t m=1<<(rnd(f)%16);              for(int t=a;t<a+len;t++)s[t]^=m;break;} // toggle a key
+      case 2: memcpy(s+a,f->corpus[rnd(f)%f->corpus_size]+a,(f->frames-a)*sizeof(uint16_t)); break; // splice
+      case 3: memmove(s+a+1,s+a,(f->frames-a-1)*sizeof(uint16_t));                           break; // delay
+    }
+  }
+}
+
+/**
+*
+*  Crashes
+*
+**/
+
+int minimize(fuzzer*f,uint16_t*s,int frames,uint32_t seed,char*message){
+  // returns the length of the minimized schedule, or -1 if it does not reproduce
+  int len=replay(f,s,frames,seed)+1, budget=REPLAY_MAX;
+  if(len<=0||strcmp(f->scratch->halt_message,message))return -1;
+  uint16_t*t=malloc(frames*sizeof(uint16_t));
+  for(int chunk=len/2;chunk>=1;chunk/=2)for(int a=0;a+chunk<len&&budget>0;a+=chunk){
+    // try removing frames entirely, to reach the crash sooner
+    memcpy(t,s,a*sizeof(uint16_t));
+    memcpy(t+a,s+a+chunk,(len-a-chunk)*sizeof(uint16_t));
+    int r=replay(f,t,len-chunk,seed)+1;
+    budget--;
+    if(r>0&&!strcmp(f->scratch->halt_message,message))memcpy(s,t,r*sizeof(uint16_t)),len=r,a-=chunk;
+  }
+  for(int chunk=len/2;chunk>=1;chunk/=2)for(int a=0;a<len&&budget>0;a+=chunk){
+    // try releasing keys
+    int any=0, b=a+chunk<len?a+chunk:len;
+    for(int z=a;z<b;z++)any|=s[z];
+    if(!any)continue;
+    memcpy(t,s,len*sizeof(uint16_t));
+    memset(t+a,0,(b-a)*sizeof(uint16_t));
+    int r=replay(f,t,len,seed)+1;
+    budget--;
+    if(r>0&&!strcmp(f->scratch->halt_message,message))memcpy(s,t,r*sizeof(uint16_t)),len=r;
+  }
+  free(t);
+  replay(f,s,len,seed);
+  return len;
+}
+
+int seen_crash(fuzzer*f,char*message,int pc){
+  // remember every distinct crash, and report whether this one is new
+  char key[OCTO_HALT_MAX+16];
+  snprintf(key,sizeof(key),"%s@%04X",message,pc);
+  for(int z=0;z<f->crash_count;z++)if(!strcmp(f->crashes[z],key))return 1;
+  if(f->crash_count>=CRASHES_MAX)return 1;
+  f->crashes[f->crash_count++]=strcpy(malloc(strlen(key)+1),key);
+  return 0;
+}
+
+void save_crash(fuzzer*f,octo_emulator*e,uint16_t*sched,uint32_t seed){
+  if(seen_crash(f,e->halt_message,e->pc))return;
+  char message[OCTO_HALT_MAX];
+  snprintf(message,sizeof(message),"%s",e->halt_message);
+  uint16_t*s=malloc(f->frames*sizeof(uint16_t));
+  memcpy(s,sched,f->frames*sizeof(uint16_t));
+  int len=minimize(f,s,f->frames,seed,message);
+  if(len<0){printf("crash did not reproduce: %s (pc 0x%04X)\n",message,e->pc);free(s);return;}
+  if(f->scratch->pc!=e->pc&&seen_crash(f,message,f->scratch->pc)){free(s);return;}
+  char path[4096];
+  snprintf(path,sizeof(path),"%s/crash-%03d.keys",f->out,f->saved++);
+  FILE*out=fopen(path,"w");
+  if(out==NULL){fprintf(stderr,"%s: unable to write trace\n",path);free(s);return;}
+  fprintf(out,"# %s (pc 0x%04X, frame %d)\n",message,f->scratch->pc,len-1);
+  fprintf(out,"seed %u\nframes %d\n",seed,len);
+  for(int t=0;t<len;t++)if(t==0||s[t]!=s[t-1])fprintf(out,"%d %04X\n",t,s[t]);
+  fclose(out);
+  printf("crash: %s (pc 0x%04X, frame %d) -> %s\n",message,f->scratch->pc,len-1,path);
+  free(s);
+}
+
+int load_trace(char*filename,uint16_t**sched,int*frames,uint32_t*seed){
+  FILE*in=fopen(filename,"r");
+  if(in==NULL)return 0;
+  char line[256];
+  int t=0, len=0; unsigned int m=0;
+  *sched=NULL, *frames=0, *seed=0;
+  while(fgets(line,sizeof(line),in)){
+    if(line[0]=='#')continue;
+    if(sscanf(line,"seed %u",seed)==1)continue;
+    if(sscanf(line,"frames %d",frames)==1){*sched=calloc(*frames>0?*frames:1,sizeof(uint16_t));continue;}
+    if(*sched&&sscanf(line,"%d %x",&t,&m)==2&&t>=0&&t<*frames)for(len=t;len<*frames;len++)(*sched)[len]=m;
+  }
+  fclose(in);
+  return *sched!=NULL;
+}
+
+/**
+*
+*  Main
+*
+**/
+
+int main(int argc,char**argv){
+  if(argc<2){
+    printf("octo-fuzz v%s\n",VERSION);
+    printf("usage: %s <source> [-n <rounds>] [-b <instances>] [-j <threads>] [-f <frames>] [-t <tickrate>] [-w <lo> <hi>] [-o <dir>] [-s <seed>] [-r <trace>]\n",argv[0]);
+    printf("  -n: number of rounds to run (default 100)\n");
+    printf("  -b: instances run per round (default 256)\n");
+    printf("  -j: number of threads (default: one per core)\n");
+    printf("  -f: frames in each key schedule (default 600)\n");
+    printf("  -t: override the tickrate of the program\n");
+    printf("  -w: memory the program may write to (default 0x200 0x10000)\n");
+    printf("  -o: directory for crash traces (default .)\n");
+    printf("  -s: seed for the fuzzer (default 1)\n");
+    printf("  -r: replay a crash trace instead of fuzzing\n");
+    return 0;
+  }
+  char*filename=NULL, *trace=NULL;
+  int rounds=100, instances=256, threads=1, frames=600, tickrate=0;
+  fuzzer*f=calloc(1,sizeof(fuzzer));
+  f->lo=0x200, f->hi=0x10000, f->out=".", f->rng=1;
+#if defined(_SC_NPROCESSORS_ONLN)
+  threads=sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  for(int z=1;z<argc;z++){
+    if     (!strcmp(argv[z],"-n")&&z+1<argc)rounds=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-b")&&z+1<argc)instances=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-j")&&z+1<argc)threads=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-f")&&z+1<argc)frames=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-t")&&z+1<argc)tickrate=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-w")&&z+2<argc)f->lo=strtol(argv[z+1],NULL,0),f->hi=strtol(argv[z+2],NULL,0),z+=2;
+    else if(!strcmp(argv[z],"-o")&&z+1<argc)f->out=argv[++z];
+    else if(!strcmp(argv[z],"-s")&&z+1<argc)f->rng=strtoul(argv[++z],NULL,0);
+    else if(!strcmp(argv[z],"-r")&&z+1<argc)trace=argv[++z];
+    else filename=argv[z];
+  }
+  if(filename==NULL){fprintf(stderr,"no source file specified.\n");return 1;}
+  if(instances<1||frames<1){fprintf(stderr,"instances and frames must be positive.\n");return 1;}
+  if(f->rng==0)f->rng=1;
+
+  // read input { .ch8, .8o, .gif }
+  octo_options o;
+  octo_default_options(&o);
+  octo_source source;
+  if(strcmp(".gif",filename+(strlen(filename)-4))==0){
+    source.data=octo_cart_load(filename,&o), source.mapped=0;
+    if(source.data==NULL){fprintf(stderr,"%s: Unable to load octocart\n",filename);return 1;}
+    source.size=strlen(source.data);
+  }
+  else if(!octo_source_open(&source,filename)){
+    fprintf(stderr,"%s: No such file or directory\n",filename);return 1;
+  }
+  if(tickrate>0)o.tickrate=tickrate;
+  octo_emulator*model=malloc(sizeof(octo_emulator));
+  if(strcmp(".ch8",filename+(strlen(filename)-4))==0){
+    octo_emulator_init(model,source.data,source.size,&o,NULL);
+  }
+  else {
+    octo_program*p=octo_compile_program(octo_program_path(octo_program_init_buffer(source.data,source.size,0),filename));
+    if(p->is_error&&octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
+    if(p->is_error){fprintf(stderr,"(%d:%d) %s\n",p->error_line+1,p->error_pos+1,p->error);return 1;}
+    octo_emulator_init(model,(char*)p->rom+0x200,p->length-0x200,&o,NULL);
+    octo_free_program(p);
+  }
+  octo_source_close(&source);
+
+  if(trace){
+    uint16_t*s; int len; uint32_t seed;
+    if(!load_trace(trace,&s,&len,&seed)){fprintf(stderr,"%s: Unable to load trace\n",trace);return 1;}
+    f->batch=octo_batch_create(model,1,1);
+    f->scratch=octo_batch_get(f->batch,0);
+    int t=replay(f,s,len,seed);
+    if(t<0||!f->scratch->halt_message[0])printf("no crash after %d frames.\n",len);
+    else printf("halted at frame %d: %s (pc 0x%04X)\n",t,f->scratch->halt_message,f->scratch->pc);
+    return 0;
+  }
+
+  f->frames=frames;
+  f->batch=octo_batch_create(model,instances,threads);
+  octo_batch_cover(f->batch);
+  f->scratch=malloc(sizeof(octo_emulator));
+  memcpy(f->scratch,&f->batch->model,sizeof(octo_emulator));
+  f->sched=calloc(instances*frames,sizeof(uint16_t));
+  f->seeds=calloc(instances,sizeof(uint32_t));
+  f->corpus[f->corpus_size++]=calloc(frames,sizeof(uint16_t));
+  long runs=0;
+  for(int r=0;r<rounds;r++){
+    for(int k=0;k<instances;k++){
+      uint16_t*s=f->sched+k*frames;
+      memcpy(s,f->corpus[rnd(f)%f->corpus_size],frames*sizeof(uint16_t));
+      if(r>0||k>0)mutate(f,s);
+    }
+    f->batch->model.seed=rnd(f);
+    octo_batch_reset(f->batch);
+    for(int k=0;k<instances;k++)f->seeds[k]=octo_batch_get(f->batch,k)->seed;
+    octo_batch_run(f->batch,frames,fuzz_input,f);
+    runs+=instances;
+    for(int k=0;k<instances;k++){
+      octo_emulator*e=octo_batch_get(f->batch,k);
+      uint8_t*c=f->batch->cover+k*OCTO_BATCH_COVER;
+      int fresh=0;
+      for(int z=0;z<OCTO_BATCH_COVER;z++)if(c[z]&~f->cover[z])fresh=1,f->cover[z]|=c[z];
+      if(fresh&&f->corpus_size<CORPUS_MAX){
+        f->corpus[f->corpus_size]=malloc(frames*sizeof(uint16_t));
+        memcpy(f->corpus[f->corpus_size++],f->sched+k*frames,frames*sizeof(uint16_t));
+      }
+      check_writes(f,e);
+      if(e->halt&&e->halt_message[0])save_crash(f,e,f->sched+k*frames,f->seeds[k]);
+    }
+  }
+  int covered=0;
+  for(int z=0;z<OCTO_BATCH_COVER;z++)for(int b=0;b<8;b++)covered+=(f->cover[z]>>b)&1;
+  printf("%ld runs: %d addresses covered, %d schedules in corpus, %d crashes.\n",runs,covered,f->corpus_size,f->saved);
+  octo_batch_destroy(f->batch);
+  return 0;
+}
@@ -0,0 +1,183 @@
+/**
+*
+*  Octo JIT
+*
+*  A headless runner for the c-octo emulator core
+*  which executes programs through the basic-block
+*  translator, with a differential mode which checks
+*  it against the reference interpreter, and a batch
+*  mode which runs many instances of the program at once.
+*
+**/
+
+#include "octo_compiler.h"
+#include "octo_emulator.h"
+#include "octo_cartridge.h"
+#include "octo_jit.h"
+#include "octo_batch.h"
+#include "octo_profile.h"
+#include "octo_trace.h"
+#include <time.h>
+
+void frame(octo_emulator*e,octo_jit*j){
+  if(e->halt)return;
+  for(int z=0;z<e->options.tickrate&&!e->halt&&!e->wait;){
+    int vblank=e->options.q_vblank&&(e->ram[e->pc]&0xF0)==0xD0;
+    if(j){z+=octo_jit_run(j,e,e->options.tickrate-z);}
+    else {int pc=e->pc;octo_emulator_instruction(e),z++;z+=octo_emulator_idle(e,pc,e->options.tickrate-z);}
+    if(vblank)break;
+  }
+  if(e->dt>0)e->dt--;
+  if(e->st>0)e->st--,e->had_sound=1;
+}
+
+void batch_input(octo_emulator*e,int index,int frame,void*user){
+  // each instance holds a pseudorandom key (or none) for 8 frames at a time
+  (void)user;
+  uint32_t h=(index*2654435761u)^((frame/8)*40503u);
+  h^=h>>15, h*=0x2C1B3C6D, h^=h>>12;
+  memset(e->keys,0,sizeof(e->keys));
+  if(h&1)e->keys[(h>>4)&0xF]=1;
+}
+
+double wall(void){
+#if defined(CLOCK_MONOTONIC)
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec+t.tv_nsec/1e9;
+#else
+  return clock()/(double)CLOCKS_PER_SEC;
+#endif
+}
+
+char* compare(octo_emulator*a,octo_emulator*b){
+  if(a->pc!=b->pc)                         return "pc";
+  if(a->i !=b->i )                         return "i";
+  if(memcmp(a->v,b->v,sizeof(a->v)))       return "v registers";
+  if(a->rp!=b->rp||memcmp(a->ret,b->ret,sizeof(a->ret))) return "return stack";
+  if(a->dt!=b->dt||a->st!=b->st)           return "timers";
+  if(a->ticks!=b->ticks)                   return "ticks";
+  if(a->halt!=b->halt)                     return "halt";
+  if(memcmp(a->ram,b->ram,sizeof(a->ram))) return "ram";
+  if(memcmp(a->px,b->px,sizeof(a->px)))    return "display";
+  if(memcmp(a->flags,b->flags,sizeof(a->flags))||a->plane!=b->plane||a->pitch!=b->pitch) return "misc state";
+  return NULL;
+}
+
+int main(int argc,char**argv){
+  if(argc<2){
+    printf("octo-jit v%s\n",VERSION);
+    printf("usage: %s <source> [-f <frames>] [-t <tickrate>] [-q] [-i] [-n] [-d] [-b <instances> [-j <threads>] [-r <rounds>]] [-p <path>] [-o <path>]\n",argv[0]);
+    printf("  -f: number of frames to run (default 600)\n");
+    printf("  -t: override the tickrate of the program\n");
+    printf("  -q: enable the shift, loadstore, jump0, logic and clip quirks\n");
+    printf("  -i: run the reference interpreter instead of the translator\n");
+    printf("  -n: run the translator's micro-ops alone, without native code\n");
+    printf("  -d: run both in lockstep and report the first divergence\n");
+    printf("  -b: run many instances of the program with different seeds and inputs\n");
+    printf("  -j: number of threads for -b (default 1)\n");
+    printf("  -r: number of times to reset and rerun the batch (default 1)\n");
+    printf("  -p: profile the interpreter, writing <path> and <path>.folded\n");
+    printf("  -o: trace the interpreter, writing the last instructions to <path> if it halts\n");
+    return 0;
+  }
+  char*filename=NULL, *profile_path=NULL, *trace_path=NULL;
+  int frames=600, tickrate=0, quirks=0, interpret=0, portable=0, diff=0, instances=0, threads=1, rounds=1;
+  for(int z=1;z<argc;z++){
+    if     (!strcmp(argv[z],"-f")&&z+1<argc)frames=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-t")&&z+1<argc)tickrate=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-q"))quirks=1;
+    else if(!strcmp(argv[z],"-i"))interpret=1;
+    else if(!strcmp(argv[z],"-n"))portable=1;
+    else if(!strcmp(argv[z],"-d"))diff=1;
+    else if(!strcmp(argv[z],"-b")&&z+1<argc)instances=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-j")&&z+1<argc)threads=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-r")&&z+1<argc)rounds=atoi(argv[++z]);
+    else if(!strcmp(argv[z],"-p")&&z+1<argc)profile_path=argv[++z],interpret=1;
+    else if(!strcmp(argv[z],"-o")&&z+1<argc)trace_path=argv[++z],interpret=1;
+    else filename=argv[z];
+  }
+  if(filename==NULL){fprintf(stderr,"no source file specified.\n");return 1;}
+
+  // read input { .ch8, .8o, .gif }
+  octo_options o;
+  octo_default_options(&o);
+  octo_source source;
+  if(strcmp(".gif",filename+(strlen(filename)-4))==0){
+    source.data=octo_cart_load(filename,&o), source.mapped=0;
+    if(source.data==NULL){fprintf(stderr,"%s: Unable to load octocart\n",filename);return 1;}
+    source.size=strlen(source.data);
+  }
+  else if(!octo_source_open(&source,filename)){
+    fprintf(stderr,"%s: No such file or directory\n",filename);return 1;
+  }
+  if(tickrate>0)o.tickrate=tickrate;
+  if(quirks)o.q_shift=o.q_loadstore=o.q_jump0=o.q_logic=o.q_clip=1;
+  octo_emulator*a=malloc(sizeof(octo_emulator)), *b=malloc(sizeof(octo_emulator));
+  octo_program*p=NULL;
+  if(strcmp(".ch8",filename+(strlen(filename)-4))==0){
+    octo_emulator_init(a,source.data,source.size,&o,NULL);
+  }
+  else {
+    p=octo_compile_program(octo_program_path(octo_program_init_buffer(source.data,source.size,0),filename));
+    if(p->is_error&&octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
+    if(p->is_error){fprintf(stderr,"(%d:%d) %s\n",p->error_line+1,p->error_pos+1,p->error);return 1;}
+    octo_emulator_init(a,(char*)p->rom+0x200,p->length-0x200,&o,NULL);
+    for(int z=0;z<p->watches.count;z++){
+      octo_watch*w=octo_list_get(&p->watches,z);
+      octo_emulator_watch(a,w->base,w->len,w->read);
+    }
+  }
+  octo_source_close(&source);
+  memcpy(b,a,sizeof(octo_emulator));
+  octo_jit*j=octo_jit_create();
+  if(portable)j->native=0;
+
+  if(instances>0){
+    octo_batch*batch=octo_batch_create(a,instances,threads);
+    double start=wall();
+    for(int r=0;r<rounds;r++){
+      if(r)octo_batch_reset(batch);
+      octo_batch_run(batch,frames,batch_input,NULL);
+    }
+    double t=wall()-start;
+    long ticks=0; int halted=0; uint32_t sum=2166136261u;
+    for(int k=0;k<instances;k++){
+      octo_emulator*e=octo_batch_get(batch,k);
+      ticks+=e->ticks, halted+=e->halt;
+      for(size_t z=0;z<sizeof(e->px);z++)sum=(sum^e->px[z])*16777619u;
+      for(int z=0;z<16;z++)sum=(sum^e->v[z])*16777619u;
+      sum=(sum^e->pc)*16777619u, sum=(sum^e->i)*16777619u;
+    }
+    printf("%d instances on %d threads: %ld ticks in %.3fs (%.1f Mips). (%d halted, checksum %08X)\n",instances,batch->threads,ticks,t,t>0?ticks*(double)rounds/t/1e6:0,halted,sum);
+    octo_batch_destroy(batch);
+    return 0;
+  }
+  if(diff){
+    // both sides see the same rand() sequence each frame
+    for(int f=0;f<frames;f++){
+      srand(f), frame(a,NULL);
+      srand(f), frame(b,j);
+      char*d=compare(a,b);
+      if(d){
+        printf("divergence in %s at frame %d (interpreter pc 0x%04X, translator pc 0x%04X)\n",d,f,a->pc,b->pc);
+        return 1;
+      }
+      if(a->halt)break;
+    }
+    printf("no divergence after %ld ticks. (%ld blocks, %ld invalidations)\n",a->ticks,j->blocks,j->writes);
+    return 0;
+  }
+  octo_profile*profile=NULL;
+  if(profile_path)profile=calloc(1,sizeof(octo_profile)),octo_emulator_profile(a,profile);
+  octo_trace*trace=NULL;
+  if(trace_path)trace=calloc(1,sizeof(octo_trace)),octo_emulator_trace(a,trace);
+  clock_t start=clock();
+  for(int f=0;f<frames&&!a->halt;f++)frame(a,interpret?NULL:j);
+  double t=(clock()-start)/(double)CLOCKS_PER_SEC;
+  printf("%ld ticks in %.3fs (%.1f Mips). (%ld blocks, %ld invalidations, %ld flushes)\n",a->ticks,t,t>0?a->ticks/t/1e6:0,j->blocks,j->writes,j->flushes);
+  if(a->halt&&a->halt_message[0])printf("halted: %s\n",a->halt_message);
+  if(profile&&!octo_profile_save(profile,a,p,profile_path))return 1;
+  if(trace&&a->halt&&!octo_trace_save(trace,a,trace_path))return 1;
+  return 0;
+}
@@ -0,0 +1,404 @@
+/**
+*
+*  octo_jit.h
+*
+*  a basic-block translator for the octo_emulator core.
+*  straight-line runs of CHIP-8 ops are decoded once into
+*  compact micro-ops with quirk flags resolved at translation
+*  time, and replayed from a cache indexed by address.
+*  display, scrolling, input and memory-writing ops fall
+*  back to octo_emulator_instruction(), and writes which
+*  land on translated code invalidate the blocks holding
+*  it. like the core, this is portable C and depends only
+*  upon the C standard library.
+*
+*  on x86-64 linux, the leading register ops of each block
+*  are also compiled to native code which holds the v
+*  registers it touches in host registers, and the block's
+*  micro-ops pick up where that code stops. where executable
+*  memory cannot be had, the micro-ops run alone.
+*
+**/
+
+#if defined(__x86_64__)&&defined(__linux__)
+#include <sys/mman.h>
+#include <stdarg.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS 0x20 // linux's value, which strict c99 hides
+#endif
+#define OCTO_JIT_NATIVE
+#endif
+
+/**
+*
+*  Micro-ops
+*
+**/
+
+#define OCTO_JIT_OPS_MAX   (64*1024)
+#define OCTO_JIT_BLOCK_MAX 64
+#define OCTO_JIT_TEXT_MAX  (4*1024*1024)
+#define OCTO_JIT_TEXT_BLOCK 4096 // native code bytes a single block can need, at most
+
+enum {
+  // block header: n is the number of CHIP-8 ops in the block, x the
+  // number of its micro-ops which run as native code, and y is set
+  // if that code runs the whole block, terminator included
+  OCTO_JIT_BLOCK,
+  // straight-line ops
+  OCTO_JIT_LD, OCTO_JIT_ADD, OCTO_JIT_MOV, OCTO_JIT_OR, OCTO_JIT_AND, OCTO_JIT_XOR,
+  OCTO_JIT_OR_VF, OCTO_JIT_AND_VF, OCTO_JIT_XOR_VF, OCTO_JIT_ADDC, OCTO_JIT_SUB, OCTO_JIT_SUBN,
+  OCTO_JIT_SHR, OCTO_JIT_SHL, OCTO_JIT_LDI, OCTO_JIT_ADDI, OCTO_JIT_RAND, OCTO_JIT_GETDT,
+  OCTO_JIT_SETDT, OCTO_JIT_SETST, OCTO_JIT_FONT, OCTO_JIT_BIGFONT, OCTO_JIT_LOAD, OCTO_JIT_LOADI,
+  OCTO_JIT_LOADR, OCTO_JIT_PLANE, OCTO_JIT_PITCH, OCTO_JIT_SAVEF, OCTO_JIT_LOADF,
+  // terminators: next is the address following the op
+  OCTO_JIT_END, OCTO_JIT_JP, OCTO_JIT_JP0, OCTO_JIT_CALL, OCTO_JIT_RET, OCTO_JIT_SE, OCTO_JIT_SNE,
+  OCTO_JIT_SER, OCTO_JIT_SNER, OCTO_JIT_SKP, OCTO_JIT_SKNP,
+};
+
+typedef struct {
+  uint8_t  op;   // OCTO_JIT_...
+  uint8_t  x;    // destination register
+  uint8_t  y;    // source register
+  uint16_t n;    // immediate, target address or block length
+  uint16_t next; // address following a terminator
+} octo_jit_op;
+
+typedef struct {
+  int         entry[64*1024]; // 1 + index of the block header for each address, 0 if untranslated, -1 if untranslatable
+  uint8_t     code[64*1024/8];// which bytes of ram hold translated code? (bitmap)
+  octo_jit_op ops[OCTO_JIT_OPS_MAX];
+  int         count;          // used micro-ops
+  long        blocks;         // blocks translated since creation
+  long        flushes;        // cache flushes caused by exhaustion
+  long        writes;         // invalidations caused by writes to translated code
+  int         native;         // compile blocks to native code?
+  uint8_t*    text;           // native code, or NULL
+  int         text_used;      // used bytes of text
+  int         text_at[OCTO_JIT_OPS_MAX]; // offset into text of the code for each block header
+} octo_jit;
+
+octo_jit* octo_jit_create(void){
+  octo_jit*j=calloc(1,sizeof(octo_jit));
+#ifdef OCTO_JIT_NATIVE
+  void*t=mmap(NULL,OCTO_JIT_TEXT_MAX,PROT_READ|PROT_WRITE|PROT_EXEC,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if(t!=MAP_FAILED)j->text=t, j->native=1;
+#endif
+  return j;
+}
+void octo_jit_destroy(octo_jit*j){
+#ifdef OCTO_JIT_NATIVE
+  if(j->text)munmap(j->text,OCTO_JIT_TEXT_MAX);
+#endif
+  free(j);
+}
+void octo_jit_flush(octo_jit*j){
+  memset(j->entry,0,sizeof(j->entry)), memset(j->code,0,sizeof(j->code));
+  j->count=0, j->text_used=0, j->flushes++;
+}
+void octo_jit_mark(octo_jit*j,int a,int b){for(int z=a;z<b;z++)j->code[z>>3]|=1<<(z&7);}
+void octo_jit_invalidate(octo_jit*j,int a,int len){
+  // drop every block which could contain a written byte of translated code.
+  // stale code bits are harmless: they only cause extra invalidations.
+  for(int z=a;z<a+len&&z<64*1024;z++){
+    if(!((j->code[z>>3]>>(z&7))&1))continue;
+    for(int b=z-2*OCTO_JIT_BLOCK_MAX<0?0:z-2*OCTO_JIT_BLOCK_MAX;b<=z;b++)j->entry[b]=0;
+    j->writes++;
+  }
+}
+
+/**
+*
+*  Native Code
+*
+**/
+
+#ifdef OCTO_JIT_NATIVE
+
+// v registers are given host registers in this order: first
+// those a callee may clobber, then those it must preserve.
+// rdi holds the emulator throughout, and al is scratch.
+uint8_t octo_x64_pool[]={2,6,8,9,10,11,3,5,12,13,14,15}; // rdx rsi r8-r11 rbx rbp r12-r15
+#define OCTO_X64_FREE 6 // registers at the head of the pool which need not be saved
+
+typedef struct {
+  uint8_t*p;       // next byte to emit
+  int     reg[16]; // host register for each v register, or -1
+} octo_x64;
+
+void octo_x64_emit(octo_x64*c,int n,...){
+  va_list a;
+  va_start(a,n);
+  for(int z=0;z<n;z++)*c->p++=va_arg(a,int);
+  va_end(a);
+}
+void octo_x64_rr(octo_x64*c,int op,int src,int dst){
+  // a byte op, dst op= src. the REX prefix is always present so
+  // that sil, dil, bpl and r8b-r15b can be addressed.
+  octo_x64_emit(c,3,0x40|((src>>3)<<2)|(dst>>3),op,0xC0|((src&7)<<3)|(dst&7));
+}
+void octo_x64_mem(octo_x64*c,int prefix,int op,int reg,size_t disp){
+  // op reg, [rdi+disp32] or the reverse
+  if(prefix)octo_x64_emit(c,1,prefix);
+  octo_x64_emit(c,7,0x40|((reg>>3)<<2),op,0x87|((reg&7)<<3),disp&0xFF,(disp>>8)&0xFF,(disp>>16)&0xFF,(disp>>24)&0xFF);
+}
+void octo_x64_setcc(octo_x64*c,int cc,int dst){octo_x64_emit(c,4,0x40|(dst>>3),0x0F,cc,0xC0|(dst&7));}
+void octo_x64_movzx(octo_x64*c,int src){octo_x64_emit(c,4,0x40|(src>>3),0x0F,0xB6,0xC0|(src&7));} // eax=src
+
+int octo_x64_uses(octo_jit_op*o){
+  // the v registers an op touches, or -1 if it has no native form
+  int x=1<<o->x, y=1<<o->y, f=1<<0xF;
+  switch(o->op){
+    case OCTO_JIT_LDI: case OCTO_JIT_PLANE:                                          return 0;
+    case OCTO_JIT_LD:  case OCTO_JIT_ADD:  case OCTO_JIT_GETDT: case OCTO_JIT_SETDT:
+    case OCTO_JIT_SETST: case OCTO_JIT_PITCH: case OCTO_JIT_ADDI: case OCTO_JIT_FONT:
+    case OCTO_JIT_BIGFONT:                                                           return x;
+    case OCTO_JIT_MOV: case OCTO_JIT_OR:   case OCTO_JIT_AND:   case OCTO_JIT_XOR:   return x|y;
+    case OCTO_JIT_OR_VF: case OCTO_JIT_AND_VF: case OCTO_JIT_XOR_VF: case OCTO_JIT_ADDC:
+    case OCTO_JIT_SUB: case OCTO_JIT_SUBN: case OCTO_JIT_SHR:   case OCTO_JIT_SHL:   return x|y|f;
+    case OCTO_JIT_END: case OCTO_JIT_JP:                                             return 0;
+    case OCTO_JIT_JP0: case OCTO_JIT_SE:   case OCTO_JIT_SNE:                        return x;
+    case OCTO_JIT_SER: case OCTO_JIT_SNER:                                           return x|y;
+  }
+  return -1;
+}
+
+void octo_x64_pc(octo_x64*c,int pc){size_t d=offsetof(octo_emulator,pc);octo_x64_emit(c,9,0x66,0xC7,0x87,d&0xFF,(d>>8)&0xFF,(d>>16)&0xFF,(d>>24)&0xFF,pc&0xFF,pc>>8);}
+void octo_x64_skip(octo_x64*c,int cmov,int next,int skip){
+  // pc=next, or next+skip if the flags satisfy cmov
+  octo_x64_emit(c,13,0xB8,next&0xFF,next>>8,0,0,0xB9,(next+skip)&0xFF,(next+skip)>>8,0,0,0x0F,cmov,0xC1);
+  octo_x64_mem(c,0x66,0x89,0,offsetof(octo_emulator,pc));
+}
+
+void octo_x64_block(octo_jit*j,octo_emulator*e,octo_jit_op*h,int pc,uint8_t*text){
+  // compile the leading micro-ops of a block which have a native form.
+  // skips are compiled with the length of the op they pass over, so
+  // that op is marked as code, to be invalidated with the block.
+  int used=0, regs=0;
+  octo_jit_op*o=h+1;
+  for(;;o++){
+    int u=octo_x64_uses(o), n=0;
+    if(u<0||(o->op>=OCTO_JIT_SE&&o->next+2-pc>2*OCTO_JIT_BLOCK_MAX))break;
+    for(int r=used|u;r;r&=r-1)n++;
+    if(n>(int)sizeof(octo_x64_pool))break;
+    used|=u, regs=n;
+    if(o->op>=OCTO_JIT_END){h->y=1,o++;break;}
+  }
+  int count=o-h-1;
+  if(count==0)return;
+  octo_x64 c={text,{0}};
+  for(int z=0,k=0;z<16;z++)c.reg[z]=(used>>z)&1?octo_x64_pool[k++]:-1;
+  for(int z=OCTO_X64_FREE;z<regs;z++)octo_x64_emit(&c,2,0x40|(octo_x64_pool[z]>>3),0x50+(octo_x64_pool[z]&7)); // push
+  for(int z=0;z<16;z++)if(c.reg[z]>=0)octo_x64_mem(&c,0,0x8A,c.reg[z],offsetof(octo_emulator,v)+z);
+  size_t oi=offsetof(octo_emulator,i);
+  for(octo_jit_op*o=h+1;o<=h+count;o++){
+    int x=c.reg[o->x], y=c.reg[o->y], f=c.reg[0xF];
+    switch(o->op){
+      case OCTO_JIT_LD:      octo_x64_emit(&c,3,0x40|(x>>3),0xB0+(x&7),o->n);                break;
+      case OCTO_JIT_ADD:     octo_x64_emit(&c,4,0x40|(x>>3),0x80,0xC0|(x&7),o->n);           break;
+      case OCTO_JIT_MOV:     octo_x64_rr(&c,0x88,y,x);                                        break;
+      case OCTO_JIT_OR:      octo_x64_rr(&c,0x08,y,x);                                        break;
+      case OCTO_JIT_AND:     octo_x64_rr(&c,0x20,y,x);                                        break;
+      case OCTO_JIT_XOR:     octo_x64_rr(&c,0x30,y,x);                                        break;
+      case OCTO_JIT_OR_VF:   octo_x64_rr(&c,0x08,y,x), octo_x64_emit(&c,3,0x40|(f>>3),0xB0+(f&7),0); break;
+      case OCTO_JIT_AND_VF:  octo_x64_rr(&c,0x20,y,x), octo_x64_emit(&c,3,0x40|(f>>3),0xB0+(f&7),0); break;
+      case OCTO_JIT_XOR_VF:  octo_x64_rr(&c,0x30,y,x), octo_x64_emit(&c,3,0x40|(f>>3),0xB0+(f&7),0); break;
+      case OCTO_JIT_ADDC:    octo_x64_rr(&c,0x00,y,x), octo_x64_setcc(&c,0x92,f);             break; // setc
+      case OCTO_JIT_SUB:     octo_x64_rr(&c,0x28,y,x), octo_x64_setcc(&c,0x93,f);             break; // setnc
+      case OCTO_JIT_SUBN:    octo_x64_rr(&c,0x88,y,0), octo_x64_rr(&c,0x28,x,0), octo_x64_rr(&c,0x88,0,x), octo_x64_setcc(&c,0x93,f); break;
+      case OCTO_JIT_SHR:     octo_x64_rr(&c,0x88,y,0), octo_x64_emit(&c,2,0xD0,0xE8), octo_x64_rr(&c,0x88,0,x), octo_x64_setcc(&c,0x92,f); break;
+      case OCTO_JIT_SHL:     octo_x64_rr(&c,0x88,y,0), octo_x64_emit(&c,2,0xD0,0xE0), octo_x64_rr(&c,0x88,0,x), octo_x64_setcc(&c,0x92,f); break;
+      case OCTO_JIT_GETDT:   octo_x64_mem(&c,0,0x8A,x,offsetof(octo_emulator,dt));            break;
+      case OCTO_JIT_SETDT:   octo_x64_mem(&c,0,0x88,x,offsetof(octo_emulator,dt));            break;
+      case OCTO_JIT_SETST:   octo_x64_mem(&c,0,0x88,x,offsetof(octo_emulator,st));            break;
+      case OCTO_JIT_PITCH:   octo_x64_mem(&c,0,0x88,x,offsetof(octo_emulator,pitch));         break;
+      case OCTO_JIT_LDI:     octo_x64_emit(&c,9,0x66,0xC7,0x87,oi&0xFF,(oi>>8)&0xFF,(oi>>16)&0xFF,(oi>>24)&0xFF,o->n&0xFF,o->n>>8); break;
+      case OCTO_JIT_ADDI:    octo_x64_movzx(&c,x), octo_x64_mem(&c,0x66,0x01,0,oi);           break; // add [i],ax
+      case OCTO_JIT_FONT:    octo_x64_movzx(&c,x), octo_x64_emit(&c,6,0x83,0xE0,0x0F,0x8D,0x04,0x80), octo_x64_mem(&c,0x66,0x89,0,oi); break;
+      case OCTO_JIT_BIGFONT: octo_x64_movzx(&c,x), octo_x64_emit(&c,11,0x83,0xE0,0x0F,0x8D,0x04,0x80,0x01,0xC0,0x83,0xC0,0x50), octo_x64_mem(&c,0x66,0x89,0,oi); break;
+      case OCTO_JIT_PLANE:   {size_t d=offsetof(octo_emulator,plane);octo_x64_emit(&c,10,0xC7,0x87,d&0xFF,(d>>8)&0xFF,(d>>16)&0xFF,(d>>24)&0xFF,o->x&3,0,0,0);} break;
+      case OCTO_JIT_END:     octo_x64_pc(&c,o->next);                                         break;
+      case OCTO_JIT_JP:      octo_x64_pc(&c,o->n);                                            break;
+      case OCTO_JIT_JP0:     octo_x64_movzx(&c,x), octo_x64_emit(&c,5,0x05,o->n&0xFF,o->n>>8,0,0), octo_x64_mem(&c,0x66,0x89,0,offsetof(octo_emulator,pc)); break;
+      case OCTO_JIT_SE:
+      case OCTO_JIT_SNE:
+      case OCTO_JIT_SER:
+      case OCTO_JIT_SNER: {
+        int skip=e->ram[o->next]==0xF0&&e->ram[o->next+1]==0x00?4:2;
+        if(o->op<OCTO_JIT_SER)octo_x64_emit(&c,4,0x40|(x>>3),0x80,0xF8|(x&7),o->n); // cmp x,n
+        else                  octo_x64_rr(&c,0x38,y,x);                          // cmp x,y
+        octo_x64_skip(&c,o->op==OCTO_JIT_SE||o->op==OCTO_JIT_SER?0x44:0x45,o->next,skip); // cmove, cmovne
+        octo_jit_mark(j,o->next,o->next+2);
+      } break;
+    }
+  }
+  for(int z=0;z<16;z++)if(c.reg[z]>=0)octo_x64_mem(&c,0,0x88,c.reg[z],offsetof(octo_emulator,v)+z);
+  for(int z=regs-1;z>=OCTO_X64_FREE;z--)octo_x64_emit(&c,2,0x40|(octo_x64_pool[z]>>3),0x58+(octo_x64_pool[z]&7)); // pop
+  octo_x64_emit(&c,1,0xC3); // ret
+  j->text_used+=c.p-text, h->x=count;
+}
+
+void octo_x64_call(uint8_t*text,octo_emulator*e){
+  union {void*p; void(*f)(octo_emulator*);} u;
+  u.p=text, u.f(e);
+}
+
+#endif
+
+/**
+*
+*  Translation
+*
+**/
+
+int octo_jit_decode(octo_emulator*e,uint16_t op,octo_jit_op*r){
+  int x=(op>>8)&0xF, y=(op>>4)&0xF, n=op&0xF, nn=op&0xFF, nnn=op&0xFFF;
+  r->x=x, r->y=y, r->n=nn;
+  #define octo_jo(k) return r->op=(k), 1
+  #define octo_jt(k) return r->op=(k), 2
+  if(op==0x00EE)                 octo_jt(OCTO_JIT_RET);
+  if((op&0xF0FF)==0xE09E)        octo_jt(OCTO_JIT_SKP);
+  if((op&0xF0FF)==0xE0A1)        octo_jt(OCTO_JIT_SKNP);
+  if((op&0xF00F)==0x5003)        octo_jo(OCTO_JIT_LOADR);
+  switch(op>>12){
+    case 0x1: r->n=nnn;          octo_jt(OCTO_JIT_JP);
+    case 0x2: r->n=nnn;          octo_jt(OCTO_JIT_CALL);
+    case 0x3:                    octo_jt(OCTO_JIT_SE);
+    case 0x4:                    octo_jt(OCTO_JIT_SNE);
+    case 0x5: if(n!=2)           octo_jt(OCTO_JIT_SER); break;
+    case 0x6:                    octo_jo(OCTO_JIT_LD);
+    case 0x7:                    octo_jo(OCTO_JIT_ADD);
+    case 0x9:                    octo_jt(OCTO_JIT_SNER);
+    case 0xA: r->n=nnn;          octo_jo(OCTO_JIT_LDI);
+    case 0xB: r->n=nnn, r->x=e->options.q_jump0?(nnn>>8)&0xF:0; octo_jt(OCTO_JIT_JP0);
+    case 0xC:                    octo_jo(OCTO_JIT_RAND);
+    case 0x8: switch(n){
+      case 0x0:                  octo_jo(OCTO_JIT_MOV);
+      case 0x1:                  octo_jo(e->options.q_logic?OCTO_JIT_OR_VF :OCTO_JIT_OR );
+      case 0x2:                  octo_jo(e->options.q_logic?OCTO_JIT_AND_VF:OCTO_JIT_AND);
+      case 0x3:                  octo_jo(e->options.q_logic?OCTO_JIT_XOR_VF:OCTO_JIT_XOR);
+      case 0x4:                  octo_jo(OCTO_JIT_ADDC);
+      case 0x5:                  octo_jo(OCTO_JIT_SUB);
+      case 0x7:                  octo_jo(OCTO_JIT_SUBN);
+      case 0x6: if(e->options.q_shift)r->y=x; octo_jo(OCTO_JIT_SHR);
+      case 0xE: if(e->options.q_shift)r->y=x; octo_jo(OCTO_JIT_SHL);
+    } break;
+    case 0xF: switch(nn){
+      case 0x01:                 octo_jo(OCTO_JIT_PLANE);
+      case 0x07:                 octo_jo(OCTO_JIT_GETDT);
+      case 0x15:                 octo_jo(OCTO_JIT_SETDT);
+      case 0x18:                 octo_jo(OCTO_JIT_SETST);
+      case 0x1E:                 octo_jo(OCTO_JIT_ADDI);
+      case 0x29:                 octo_jo(OCTO_JIT_FONT);
+      case 0x30:                 octo_jo(OCTO_JIT_BIGFONT);
+      case 0x3A:                 octo_jo(OCTO_JIT_PITCH);
+      case 0x65:                 octo_jo(e->options.q_loadstore?OCTO_JIT_LOAD:OCTO_JIT_LOADI);
+      case 0x75:                 octo_jo(OCTO_JIT_SAVEF);
+      case 0x85:                 octo_jo(OCTO_JIT_LOADF);
+    } break;
+  }
+  #undef octo_jo
+  #undef octo_jt
+  return 0; // unsupported: leave it to the interpreter
+}
+
+int octo_jit_translate(octo_jit*j,octo_emulator*e,uint16_t pc){
+  if(j->count+OCTO_JIT_BLOCK_MAX+2>OCTO_JIT_OPS_MAX||j->text_used+OCTO_JIT_TEXT_BLOCK>OCTO_JIT_TEXT_MAX)octo_jit_flush(j);
+  int base=j->count, len=0, kind=0;
+  octo_jit_op*h=&j->ops[j->count++];
+  h->op=OCTO_JIT_BLOCK, h->x=h->y=0;
+  uint16_t a=pc;
+  while(len<OCTO_JIT_BLOCK_MAX&&a<0xFFFE){
+    octo_jit_op*r=&j->ops[j->count];
+    if(!(kind=octo_jit_decode(e,(e->ram[a]<<8)|e->ram[a+1],r)))break;
+    j->count++, len++, a+=2, r->next=a;
+    if(kind==2)break;
+  }
+  if(len==0)return j->count=base, octo_jit_mark(j,pc,pc+2), j->entry[pc]=-1;
+  if(kind!=2){octo_jit_op*r=&j->ops[j->count++];r->op=OCTO_JIT_END,r->next=a;}
+  h->n=len, j->entry[pc]=base+1, j->blocks++;
+  octo_jit_mark(j,pc,a);
+#ifdef OCTO_JIT_NATIVE
+  if(j->native)j->text_at[base]=j->text_used, octo_x64_block(j,e,h,pc,j->text+j->text_used);
+#endif
+  return base+1;
+}
+
+/**
+*
+*  Execution
+*
+**/
+
+void octo_jit_block(octo_emulator*e,octo_jit_op*o){
+  int t;
+  uint8_t*v=e->v;
+  e->ticks+=o->n;
+  for(o+=1+o->x;;o++)switch(o->op){
+    case OCTO_JIT_LD:      v[o->x] =o->n;                                               break;
+    case OCTO_JIT_ADD:     v[o->x]+=o->n;                                               break;
+    case OCTO_JIT_MOV:     v[o->x] =v[o->y];                                            break;
+    case OCTO_JIT_OR:      v[o->x]|=v[o->y];                                            break;
+    case OCTO_JIT_AND:     v[o->x]&=v[o->y];                                            break;
+    case OCTO_JIT_XOR:     v[o->x]^=v[o->y];                                            break;
+    case OCTO_JIT_OR_VF:   v[o->x]|=v[o->y], v[0xF]=0;                                  break;
+    case OCTO_JIT_AND_VF:  v[o->x]&=v[o->y], v[0xF]=0;                                  break;
+    case OCTO_JIT_XOR_VF:  v[o->x]^=v[o->y], v[0xF]=0;                                  break;
+    case OCTO_JIT_ADDC:    t=v[o->x]+v[o->y], octo_emulator_carry(e,o->x,t,t>0xFF);     break;
+    case OCTO_JIT_SUB:     t=v[o->x]-v[o->y], octo_emulator_carry(e,o->x,t,v[o->x]>=v[o->y]); break;
+    case OCTO_JIT_SUBN:    t=v[o->y]-v[o->x], octo_emulator_carry(e,o->x,t,v[o->y]>=v[o->x]); break;
+    case OCTO_JIT_SHR:     t=v[o->y]>>1, octo_emulator_carry(e,o->x,t,v[o->y]&1);       break;
+    case OCTO_JIT_SHL:     t=v[o->y]<<1, octo_emulator_carry(e,o->x,t,v[o->y]>>7);      break;
+    case OCTO_JIT_LDI:     e->i=o->n;                                                   break;
+    case OCTO_JIT_ADDI:    e->i+=v[o->x];                                               break;
+    case OCTO_JIT_RAND:    v[o->x]=octo_emulator_random(e)&o->n, e->writes++;           break;
+    case OCTO_JIT_GETDT:   v[o->x]=e->dt;                                               break;
+    case OCTO_JIT_SETDT:   e->dt=v[o->x];                                               break;
+    case OCTO_JIT_SETST:   e->st=v[o->x];                                               break;
+    case OCTO_JIT_FONT:    e->i= 5*(v[o->x]&0xF);                                       break;
+    case OCTO_JIT_BIGFONT: e->i=10*(v[o->x]&0xF)+(5*16);                                break;
+    case OCTO_JIT_LOAD:    for(int z=0;z<=o->x;z++)v[z]=octo_get(e,z);                  break;
+    case OCTO_JIT_LOADI:   for(int z=0;z<=o->x;z++)v[z]=octo_get(e,z); e->i+=o->x+1;    break;
+    case OCTO_JIT_LOADR:   for(int z=0;z<=abs(o->x-o->y);z++)v[o->x<o->y?o->x+z:o->x-z]=octo_get(e,z); break;
+    case OCTO_JIT_PLANE:   e->plane=o->x&3;                                             break;
+    case OCTO_JIT_PITCH:   e->pitch=v[o->x];                                            break;
+    case OCTO_JIT_SAVEF:   for(int z=0;z<=o->x;z++)e->flags[z]=v[z];                    break;
+    case OCTO_JIT_LOADF:   for(int z=0;z<=o->x;z++)v[z]=e->flags[z];                    break;
+    case OCTO_JIT_END:     e->pc=o->next;                                               return;
+    case OCTO_JIT_JP:      e->pc=o->n;                                                  return;
+    case OCTO_JIT_JP0:     e->pc=o->n+v[o->x];                                          return;
+    case OCTO_JIT_RET:     e->pc=e->ret[--(e->rp)];                                     return;
+    case OCTO_JIT_CALL:
+      e->ret[e->rp++]=o->next, e->pc=o->n;
+      if(e->rp>12){e->halt=1;snprintf(e->halt_message,OCTO_HALT_MAX,"Call Stack Overflow");}
+      return;
+    case OCTO_JIT_SE:      e->pc=o->next; if(v[o->x]==o->n)      octo_emulator_skip(e); return;
+    case OCTO_JIT_SNE:     e->pc=o->next; if(v[o->x]!=o->n)      octo_emulator_skip(e); return;
+    case OCTO_JIT_SER:     e->pc=o->next; if(v[o->x]==v[o->y])   octo_emulator_skip(e); return;
+    case OCTO_JIT_SNER:    e->pc=o->next; if(v[o->x]!=v[o->y])   octo_emulator_skip(e); return;
+    case OCTO_JIT_SKP:     e->pc=o->next; if(v[o->x]<=15&& e->keys[v[o->x]]) octo_emulator_skip(e); return;
+    case OCTO_JIT_SKNP:    e->pc=o->next; if(v[o->x] >15||!e->keys[v[o->x]]) octo_emulator_skip(e); return;
+  }
+}
+
+int octo_jit_run(octo_jit*j,octo_emulator*e,int budget){
+  // run one translated block if it fits in the remaining tick budget,
+  // otherwise a single interpreted op. returns the number of ticks used.
+  if(!e->wait&&!octo_emulator_watching(e,1)){ // translated loads do not stop at read watchpoints
+    int b=j->entry[e->pc];
+    if(!b)b=octo_jit_translate(j,e,e->pc);
+    if(b>0&&j->ops[b-1].n<=budget){
+#ifdef OCTO_JIT_NATIVE
+      octo_jit_op*h=&j->ops[b-1];
+      if(h->x)octo_x64_call(j->text+j->text_at[b-1],e);
+      if(h->y)return e->ticks+=h->n, h->n;
+#endif
+      return octo_jit_block(e,&j->ops[b-1]), j->ops[b-1].n;
+    }
+  }
+  uint16_t op=(e->ram[e->pc]<<8)|e->ram[e->pc+1], i=e->i, x=(op>>8)&0xF, y=(op>>4)&0xF;
+  int len=(op&0xF00F)==0x5002?abs(x-y)+1: (op&0xF0FF)==0xF033?3: (op&0xF0FF)==0xF055?x+1: 0;
+  octo_emulator_instruction(e);
+  octo_jit_invalidate(j,i,len);
+  return 1;
+}
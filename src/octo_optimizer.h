@@ -0,0 +1,600 @@
+/**
+*
+*  octo_optimizer.h
+*
+*  an optional peephole pass over the rom of a compiled
+*  octo_program. it threads jumps and calls through the
+*  jumps they land on, turns a call followed by a return
+*  into a tail jump, and removes reloads of a value i
+*  already holds and register writes which are overwritten
+*  before they are read.
+*
+*  it works from the compiler's map of the rom (the code
+*  field): where instructions begin, which fields hold the
+*  address of a label, and which addresses are given as
+*  numbers or calculations. instructions are only removed
+*  if every address the rom holds is a label's (the program
+*  is not pinned), so that the code after them can move
+*  down, segment by segment, and those fields be relocated.
+*  code reached through jump0, native or an address used as
+*  data is left alone up to the next label, as it may be a
+*  table, or be rewritten while the program runs.
+*
+*  two more passes may be run alongside it: one drops the
+*  labelled regions of the rom that nothing reachable from
+*  main refers to, and one packs data, letting labels which
+*  hold only data that is never executed or written share
+*  the bytes they have in common. the space either frees
+*  is closed up in the same way.
+*
+**/
+
+#define OCTO_PASS_PEEPHOLE 0x01
+#define OCTO_PASS_PACK     0x02
+#define OCTO_PASS_PRUNE    0x04
+
+#define OCTO_OPT_LEADER 0x01 // a label, breakpoint or branch target is here
+#define OCTO_OPT_LABEL  0x02 // a label is here
+#define OCTO_OPT_FROZEN 0x04 // must not be changed
+#define OCTO_OPT_KEEP   0x08 // holds part of an address; must not be removed
+#define OCTO_OPT_DEAD   0x10 // removed
+
+typedef struct {
+  int threaded; // jumps and calls retargeted past a jump
+  int returns;  // jumps to a return replaced by the return
+  int tails;    // calls followed by a return made into jumps
+  int loads;    // i := removed, as i already held the address
+  int stores;   // register writes removed, as they were overwritten unread
+  int bytes;    // bytes removed from the rom
+  int held;     // bytes not removed, as the rom is pinned
+  int packed;   // bytes of data removed, as a copy is kept elsewhere
+  int pruned;   // bytes of unreachable code and data removed
+  int* saved;   // bytes packed away from each constant, by index. free() this.
+  int* unused;  // bytes removed as unreachable from each constant, by index. free() this.
+} octo_opt_stats;
+
+typedef struct {
+  octo_program*p;
+  char* f;        // OCTO_OPT_ flags of each address
+  int*  ins;      // the address of every instruction, ascending
+  int   count;
+  int*  fwd;      // where the copy of each packed byte is kept, or -1
+  octo_opt_stats*s;
+} octo_opt;
+
+/**
+*
+*  Instructions
+*
+**/
+
+#define octo_ob(a) (0xFF&p->rom[(a)&0xFFFF])
+
+int octo_opt_op(octo_program*p,int a){return (octo_ob(a)<<8)|octo_ob(a+1);}
+int octo_opt_size(int op){return op==0xF000?4:2;}
+int octo_opt_range(int op){
+  // the registers of save or load vx - vy, in either order
+  int x=(op>>8)&0xF, y=(op>>4)&0xF, lo=x<y?x:y, hi=x<y?y:x;
+  return ((2<<hi)-1)&~((1<<lo)-1);
+}
+int octo_opt_display(int op){
+  return op==0x00E0||(op&0xFFF0)==0x00C0||(op&0xFFF0)==0x00D0||(op>=0x00FB&&op<=0x00FF&&op!=0x00FD);
+}
+int octo_opt_is_skip(int op){
+  int n=op>>12;
+  return n==0x3||n==0x4||((n==0x5||n==0x9)&&(op&0xF)==0)||(n==0xE&&((op&0xFF)==0x9E||(op&0xFF)==0xA1));
+}
+int octo_opt_ends(int op){
+  // control never falls through op
+  return (op>>12)==0x1||(op>>12)==0xB||op==0x00EE||op==0x00FD;
+}
+int octo_opt_reads(int op){
+  // the registers op may read, or every register if it transfers control
+  int x=1<<((op>>8)&0xF), y=1<<((op>>4)&0xF), n=op&0xF;
+  switch(op>>12){
+    case 0x0: return octo_opt_display(op)?0:0xFFFF;
+    case 0x3: case 0x4: case 0x7: case 0xE: return x;
+    case 0x5: return n==0?x|y: n==2?octo_opt_range(op): n==3?0: 0xFFFF;
+    case 0x6: case 0xA: case 0xC: return 0;
+    case 0x8: return n==0?y:x|y;
+    case 0x9: case 0xD: return x|y;
+    case 0xF: switch(op&0xFF){
+      case 0x00: case 0x01: case 0x02: case 0x07: case 0x0A: case 0x65: case 0x85: return 0;
+      case 0x55: case 0x75: return (x<<1)-1;
+      default: return x;
+    }
+  }
+  return 0xFFFF;
+}
+int octo_opt_writes(int op){
+  // the registers op always writes
+  int x=1<<((op>>8)&0xF), n=op&0xF;
+  switch(op>>12){
+    case 0x5: return n==3?octo_opt_range(op):0;
+    case 0x6: case 0x7: case 0xC: return x;
+    case 0x8: return n<=3?x:x|0x8000;
+    case 0xD: return 0x8000;
+    case 0xF: switch(op&0xFF){
+      case 0x07: case 0x0A: return x;
+      case 0x65: case 0x85: return (x<<1)-1;
+    }
+  }
+  return 0;
+}
+int octo_opt_sets_i(int op){
+  int n=op>>12, nn=op&0xFF;
+  return n==0xA||n==0x2||(n==0x0&&!octo_opt_display(op))||op==0xF000||
+    (n==0xF&&(nn==0x1E||nn==0x29||nn==0x30||nn==0x55||nn==0x65));
+}
+
+/**
+*
+*  Relocated Fields
+*
+*  a field flagged OCTO_CODE_ADDR holds the low 12 bits of an
+*  instruction, or 16 bits of data, or is split over the two
+*  instructions of an :unpack. see octo_resolve_label().
+*
+**/
+
+int octo_opt_unpack(octo_program*p,int a){return (p->code[a]&OCTO_CODE_OP)&&(octo_ob(a)&0xF0)==0x60;}
+int octo_opt_field(octo_program*p,int a){
+  int u=octo_opt_unpack(p,a);
+  if(p->code[a]&OCTO_CODE_LONG)return u?(octo_ob(a+1)<<8)|octo_ob(a+3):(octo_ob(a)<<8)|octo_ob(a+1);
+  return u?((octo_ob(a+1)&0xF)<<8)|octo_ob(a+3):((octo_ob(a)&0xF)<<8)|octo_ob(a+1);
+}
+void octo_opt_set_field(octo_program*p,int a,int t){
+  char*r=p->rom;
+  int u=octo_opt_unpack(p,a), b=u?(a+1)&0xFFFF:a, c=u?(a+3)&0xFFFF:(a+1)&0xFFFF;
+  if(p->code[a]&OCTO_CODE_LONG)r[b]=t>>8;
+  else r[b]=(r[b]&0xF0)|((t>>8)&0xF);
+  r[c]=t;
+}
+#undef octo_ob
+
+/**
+*
+*  Analysis
+*
+**/
+
+void octo_opt_freeze(octo_opt*o,int t){
+  // leave t, the instruction around it, and what follows up to the next label as they are
+  octo_program*p=o->p;
+  for(int d=1;d<=3&&t-d>=0;d++)if(p->code[t-d]&OCTO_CODE_OP){
+    if(d<octo_opt_size(octo_opt_op(p,t-d)))o->f[t-d]|=OCTO_OPT_FROZEN;
+    break;
+  }
+  for(int a=t;a<p->length&&(a==t||!(o->f[a]&OCTO_OPT_LABEL));a++)o->f[a]|=OCTO_OPT_FROZEN;
+}
+int octo_opt_frozen(octo_opt*o,int a){
+  int n=octo_opt_size(octo_opt_op(o->p,a));
+  for(int z=0;z<n;z++)if(o->f[(a+z)&0xFFFF]&OCTO_OPT_FROZEN)return 1;
+  return 0;
+}
+void octo_opt_init(octo_opt*o,octo_program*p,octo_opt_stats*s){
+  o->p=p, o->s=s, o->count=0;
+  o->f=calloc(OCTO_RAM_MAX,1);
+  o->ins=malloc(OCTO_RAM_MAX*sizeof(int));
+  o->fwd=malloc(OCTO_RAM_MAX*sizeof(int)), memset(o->fwd,0xFF,OCTO_RAM_MAX*sizeof(int));
+  for(int a=0;a<p->length;a++)if(p->code[a]&OCTO_CODE_OP)o->ins[o->count++]=a, a+=octo_opt_size(octo_opt_op(p,a))-1;
+  for(int z=0;z<p->constants.keys.count;z++){
+    octo_const*c=octo_list_get(&p->constants.values,z);
+    if(c->is_label==1&&c->value>=0&&c->value<OCTO_RAM_MAX)o->f[(int)c->value]|=OCTO_OPT_LABEL|OCTO_OPT_LEADER;
+  }
+  for(int z=0;z<p->breaks.count;z++)o->f[((octo_break*)octo_list_get(&p->breaks,z))->addr]|=OCTO_OPT_LEADER;
+  for(int a=0;a<OCTO_RAM_MAX;a++){
+    if(!(p->code[a]&OCTO_CODE_ADDR))continue;
+    int t=octo_opt_field(p,a), n=(0xFF&p->rom[a])>>4;
+    o->f[t]|=OCTO_OPT_LEADER;
+    if(octo_opt_unpack(p,a))o->f[a]|=OCTO_OPT_KEEP, o->f[(a+2)&0xFFFF]|=OCTO_OPT_KEEP;
+    if((p->code[a]&OCTO_CODE_LONG)||!(p->code[a]&OCTO_CODE_OP)||(n!=0x1&&n!=0x2))octo_opt_freeze(o,t);
+  }
+  for(int a=0;a<OCTO_RAM_MAX;a++)if(p->code[a]&OCTO_CODE_FIXED)octo_opt_freeze(o,a);
+}
+void octo_opt_destroy(octo_opt*o){free(o->f);free(o->ins);free(o->fwd);}
+
+int octo_opt_prev(octo_opt*o,int k){
+  // the index of the instruction which falls through to instruction k, or -1
+  for(int j=k-1;j>=0;j--){
+    int a=o->ins[j], op=octo_opt_op(o->p,a);
+    if(a+octo_opt_size(op)!=o->ins[j+1])return -1;
+    if(!(o->f[a]&OCTO_OPT_DEAD))return octo_opt_ends(op)?-1:j;
+  }
+  return -1;
+}
+int octo_opt_conditional(octo_opt*o,int k){
+  int j=octo_opt_prev(o,k);
+  return j>=0&&octo_opt_is_skip(octo_opt_op(o->p,o->ins[j]));
+}
+int octo_opt_remove(octo_opt*o,int k){
+  // remove instruction k, if nothing can reach it but the instruction before
+  int a=o->ins[k], n=octo_opt_size(octo_opt_op(o->p,a));
+  if((o->f[a]&(OCTO_OPT_LEADER|OCTO_OPT_KEEP|OCTO_OPT_DEAD))||octo_opt_frozen(o,a))return 0;
+  if(octo_opt_prev(o,k)<0||octo_opt_conditional(o,k))return 0;
+  if(o->p->pinned)return o->s->held+=n, 0;
+  for(int z=0;z<n;z++)o->f[a+z]|=OCTO_OPT_DEAD;
+  return o->s->bytes+=n, 1;
+}
+
+/**
+*
+*  Passes
+*
+**/
+
+void octo_opt_tails(octo_opt*o){
+  // :call f return => jump f return, and the return is usually unreachable
+  octo_program*p=o->p;
+  for(int k=0;k+1<o->count;k++){
+    int a=o->ins[k], n=o->ins[k+1];
+    if((octo_opt_op(p,a)>>12)!=0x2||n!=a+2||octo_opt_op(p,n)!=0x00EE)continue;
+    if(octo_opt_frozen(o,a)||octo_opt_frozen(o,n))continue;
+    if(!octo_opt_conditional(o,k))octo_opt_remove(o,k+1); // otherwise, skipping the call reaches it
+    p->rom[a]=0x10|(p->rom[a]&0xF), o->s->tails++;
+  }
+}
+void octo_opt_threads(octo_opt*o){
+  // jump a, where a: jump b => jump b. likewise for :call.
+  octo_program*p=o->p;
+  for(int k=0;k<o->count;k++){
+    int a=o->ins[k], op=octo_opt_op(p,a), t=op&0xFFF;
+    if(((op>>12)!=0x1&&(op>>12)!=0x2)||(o->f[a]&OCTO_OPT_DEAD)||octo_opt_frozen(o,a))continue;
+    for(int z=0;z<16;z++){
+      int j=octo_opt_op(p,t);
+      if(!(p->code[t]&OCTO_CODE_OP)||octo_opt_frozen(o,t)||(j>>12)!=0x1||(j&0xFFF)==t)break;
+      t=j&0xFFF;
+    }
+    if(t!=(op&0xFFF))octo_opt_set_field(p,a,t), o->s->threaded++;
+    if((op>>12)==0x1&&(p->code[t]&OCTO_CODE_OP)&&!octo_opt_frozen(o,t)&&octo_opt_op(p,t)==0x00EE){
+      p->rom[a]=0x00, p->rom[a+1]=0xEE, p->code[a]&=~OCTO_CODE_ADDR, o->s->returns++;
+    }
+  }
+}
+void octo_opt_blocks(octo_opt*o){
+  // within each straight run of code, drop i := of the address i holds,
+  // and writes of constants or registers which are written again unread.
+  octo_program*p=o->p;
+  int i=-1;
+  for(int k=0;k<o->count;k++){
+    int a=o->ins[k], op=octo_opt_op(p,a);
+    if(o->f[a]&OCTO_OPT_DEAD)continue;
+    if((o->f[a]&OCTO_OPT_LEADER)||octo_opt_prev(o,k)<0)i=-1;
+    if((op>>12)==0xA){
+      int c=octo_opt_conditional(o,k), nnn=op&0xFFF;
+      if(!c&&i==nnn&&octo_opt_remove(o,k)){o->s->loads++;continue;}
+      i=octo_opt_frozen(o,a)||(c&&i!=nnn)?-1:nnn;
+    }
+    else if(octo_opt_sets_i(op))i=-1;
+
+    if((op>>12)!=0x6&&(op&0xF00F)!=0x8000)continue;
+    int x=1<<((op>>8)&0xF), last=op;
+    for(int j=k+1;j<o->count;j++){
+      int b=o->ins[j], bop=octo_opt_op(p,b);
+      if(o->ins[j-1]+octo_opt_size(octo_opt_op(p,o->ins[j-1]))!=b)break;
+      if(o->f[b]&OCTO_OPT_DEAD)continue;
+      if((o->f[b]&OCTO_OPT_LEADER)||octo_opt_frozen(o,b)||(octo_opt_reads(bop)&x))break;
+      if(!octo_opt_is_skip(last)&&(octo_opt_writes(bop)&x)){if(octo_opt_remove(o,k))o->s->stores++;break;}
+      if(octo_opt_ends(bop))break;
+      last=bop;
+    }
+  }
+}
+
+/**
+*
+*  Reachability
+*
+*  the rom is split into regions at every label and :org.
+*  starting from the region at 0x200, a region reaches
+*  those its address fields point into, the region its
+*  last instruction may fall into, and, if it holds only
+*  data, following regions of data, which may be read
+*  as part of it. monitored memory is reached as well.
+*  unreached regions are removed, and any breakpoints in
+*  them with it.
+*
+**/
+
+void octo_opt_prune(octo_opt*o){
+  octo_program*p=o->p;
+  if(p->pinned||p->length<=0x200)return;
+  o->s->unused=calloc(p->constants.keys.count+1,sizeof(int));
+  int*region=malloc(OCTO_RAM_MAX*sizeof(int)), *start=malloc(OCTO_RAM_MAX*sizeof(int)), *todo=malloc(OCTO_RAM_MAX*sizeof(int));
+  char*reached=calloc(OCTO_RAM_MAX,1), *code=calloc(OCTO_RAM_MAX,1);
+  int count=0, n=0;
+  for(int a=0x200;a<p->length;a++){
+    if(a==0x200||(o->f[a]&OCTO_OPT_LABEL)||(p->code[a]&OCTO_CODE_ORG))start[count++]=a;
+    region[a]=count-1, code[count-1]|=(p->code[a]&OCTO_CODE_OP)!=0;
+  }
+  start[count]=p->length;
+  #define octo_reach(a) {int r_=(a); if(r_>=0x200&&r_<p->length&&!reached[region[r_]])reached[region[r_]]=1, todo[n++]=region[r_];}
+  octo_reach(0x200)
+  octo_const*m=octo_map_get(&p->constants,octo_intern(p,"main"));
+  if(m)octo_reach((int)m->value)
+  for(int z=0;z<p->monitors.values.count;z++){
+    octo_mon*w=octo_list_get(&p->monitors.values,z);
+    if(w->type==1)octo_reach(w->base&0xFFFF)
+  }
+  for(int z=0;z<p->watches.count;z++)octo_reach(((octo_watch*)octo_list_get(&p->watches,z))->base&0xFFFF)
+  while(n>0){
+    int r=todo[--n], last=-1, prev=-1;
+    for(int a=start[r];a<start[r+1];a++){
+      if(p->code[a]&OCTO_CODE_ADDR)octo_reach(octo_opt_field(p,a))
+      if((p->code[a]&OCTO_CODE_OP)&&!(o->f[a]&OCTO_OPT_DEAD))prev=last, last=a;
+    }
+    if(!code[r]){if(r+1<count&&!code[r+1]&&!(p->code[start[r+1]]&OCTO_CODE_ORG))octo_reach(start[r+1]) continue;}
+    if(last<0)continue;
+    int op=octo_opt_op(p,last), end=last+octo_opt_size(op);
+    int skipped=prev>=0&&prev+octo_opt_size(octo_opt_op(p,prev))==last&&octo_opt_is_skip(octo_opt_op(p,prev));
+    if(!octo_opt_ends(op)||skipped)octo_reach(end)
+  }
+  #undef octo_reach
+  for(int r=0;r<count;r++){
+    if(reached[r])continue;
+    for(int a=start[r];a<start[r+1];a++)if(!(o->f[a]&OCTO_OPT_DEAD))o->f[a]|=OCTO_OPT_DEAD, o->s->pruned++;
+  }
+  for(int z=0;z<p->label_count;z++){
+    int a=p->labels[z].value;
+    if(a<0x200||a>=p->length||reached[region[a]]||(z>0&&p->labels[z-1].value==a))continue;
+    o->s->unused[p->labels[z].index]=start[region[a]+1]-a;
+  }
+  for(int z=p->breaks.count-1;z>=0;z--){
+    octo_break*b=octo_list_get(&p->breaks,z);
+    if(b->addr>=0x200&&b->addr<p->length&&!reached[region[b->addr]])octo_free_break(octo_list_remove(&p->breaks,z));
+  }
+  o->s->bytes+=o->s->pruned;
+  free(region), free(start), free(todo), free(reached), free(code);
+}
+
+/**
+*
+*  Data Packing
+*
+*  a label's data runs up to the next label. it may be
+*  packed if it holds nothing the compiler emitted as an
+*  instruction or an address, nothing jumps into it or
+*  falls through into it, and i is never left pointing into
+*  it, or the data after it, where code may save through i.
+*  nor may i be left pointing before it where code may go
+*  on to read past the end of that label's data, with i +=,
+*  or a load or sprite longer than the data, as the labels
+*  which follow must then stay where they are. a label whose
+*  bytes appear within other such data moves there, and a
+*  label whose data begins as the data just before it ends
+*  starts inside the latter.
+*
+**/
+
+#define OCTO_PACK_CODE    0x01 // part of an instruction or address
+#define OCTO_PACK_RUN     0x02 // may be executed
+#define OCTO_PACK_WRITTEN 0x04 // may be written through i
+#define OCTO_PACK_HOST    0x08 // holds the copy of packed bytes
+#define OCTO_PACK_SPANNED 0x10 // may be read through i set to an earlier label
+
+typedef struct { int a,e,index; } octo_pack_region;
+
+int octo_pack_region_cmp(const void*a,const void*b){
+  const octo_pack_region*x=a, *y=b;
+  // the largest first, and of equal sizes the last first, so the first copy is kept
+  return (y->e-y->a)!=(x->e-x->a)?(y->e-y->a)-(x->e-x->a):y->a-x->a;
+}
+
+int octo_opt_pack_past(int op,int*left,int planes){
+  // may op touch memory through i beyond the left bytes i has before it? left shrinks as i advances.
+  int n=op>>12, nn=op&0xFF, x=(op>>8)&0xF, y=(op>>4)&0xF, b=0;
+  if(n==0xF&&nn==0x1E)return 1;
+  if(n==0xD)b=((op&0xF)?(op&0xF):32)*(planes?2:1);
+  if(n==0x5&&((op&0xF)==0x2||(op&0xF)==0x3))b=(x<y?y-x:x-y)+1;
+  if(n==0xF&&nn==0x33)b=3;
+  if(n==0xF&&(nn==0x55||nn==0x65))b=x+1;
+  if(b>*left)return 1;
+  if(n==0xF&&(nn==0x55||nn==0x65))*left-=b;
+  return 0;
+}
+
+int octo_opt_pack_scan(octo_opt*o,int a,int call,int depth,int*seen,int stamp,int left,int moved,int planes){
+  // may the code from a write memory through i before it sets i anew? or, if left
+  // is not negative, may it touch memory more than left bytes on from where i points?
+  // 1 if it may, 0 if not, or -1 if it may return first (when call is set).
+  // moved is set once i may have advanced from where it was set.
+  octo_program*p=o->p;
+  int r=0, skip=0;
+  for(;;a+=octo_opt_size(octo_opt_op(p,a))){
+    if(a<0||a>=p->length||!(p->code[a]&OCTO_CODE_OP)||depth>32)return 1;
+    // coming around again, an advancing i may go on as far as it likes
+    if(seen[2*a+call]==stamp)return moved?1:call?-1:r;
+    seen[2*a+call]=stamp;
+    int op=octo_opt_op(p,a), n=op>>12, nn=op&0xFF, t=-2;
+    if(left<0&&((n==0xF&&(nn==0x55||nn==0x33))||(n==0x5&&(op&0xF)==0x2)))return 1;
+    if(left>=0){
+      int was=left;
+      if(octo_opt_pack_past(op,&left,planes))return 1;
+      moved|=left!=was;
+    }
+    if(n==0xA||op==0xF000||(n==0xF&&(nn==0x29||nn==0x30)))t=0;
+    else if(n==0x1)t=octo_opt_pack_scan(o,op&0xFFF,call,depth+1,seen,stamp,left,moved,planes);
+    else if(n==0x2){
+      int c=octo_opt_pack_scan(o,op&0xFFF,1,depth+1,seen,stamp,left,moved,planes);
+      if(c>=0)t=c;
+      else if(left>=0)left=0, moved=1; // i may have advanced before the return
+    }
+    else if(op==0x00EE&&call)t=-1;
+    else if(op==0x00EE){
+      // this may return to the code after any call
+      t=0;
+      for(int z=0;z<o->count&&t!=1;z++){
+        int c=o->ins[z];
+        if((octo_opt_op(p,c)>>12)==0x2&&octo_opt_pack_scan(o,c+2,0,depth+1,seen,stamp,left,moved,planes)==1)t=1;
+      }
+    }
+    else if(op==0x00FD)t=0;
+    else if(n==0xB){
+      // any instruction of the table, up to the next label, may be reached
+      int c=op&0xFFF;
+      for(t=0;c<p->length&&(p->code[c]&OCTO_CODE_OP)&&(c==(op&0xFFF)||!(o->f[c]&OCTO_OPT_LABEL));c+=octo_opt_size(octo_opt_op(p,c))){
+        int e=octo_opt_pack_scan(o,c,call,depth+1,seen,stamp,left,moved,planes);
+        if(e==1)return 1;
+        if(e==-1)t=-1;
+      }
+    }
+    else if(n==0x0&&!octo_opt_display(op))return 1;
+    if(t!=-2){
+      if(t==1)return 1;
+      if(t==-1)r=-1;
+      if(!skip)return r;
+    }
+    skip=octo_opt_is_skip(op);
+  }
+}
+
+void octo_opt_pack(octo_opt*o){
+  octo_program*p=o->p;
+  if(p->pinned)return;
+  o->s->saved=calloc(p->constants.keys.count+1,sizeof(int));
+  char*k=calloc(OCTO_RAM_MAX,1);
+  int*seen=calloc(2*OCTO_RAM_MAX,sizeof(int)), stamp=0, planes=0;
+  for(int z=0;z<o->count;z++){
+    int a=o->ins[z], n=octo_opt_size(octo_opt_op(p,a)), j=z>0?o->ins[z-1]:-1, op=octo_opt_op(p,a);
+    for(int b=0;b<n;b++)k[a+b]|=OCTO_PACK_CODE;
+    // with both planes selected, a sprite reads twice its height in bytes
+    if((op&0xF0FF)==0xF001&&(op&0x0300)==0x0300)planes=1;
+    // control may fall, or skip, past the end of this code
+    if(!octo_opt_ends(op)||(j>=0&&j+octo_opt_size(octo_opt_op(p,j))==a&&octo_opt_is_skip(octo_opt_op(p,j))))k[(a+n)&0xFFFF]|=OCTO_PACK_RUN;
+  }
+  for(int a=0;a<OCTO_RAM_MAX;a++){
+    if(!(p->code[a]&OCTO_CODE_ADDR))continue;
+    int t=octo_opt_field(p,a), op=octo_opt_op(p,a), n=op>>12, written=1;
+    if(!(p->code[a]&OCTO_CODE_OP))k[a]|=OCTO_PACK_CODE, k[(a+1)&0xFFFF]|=OCTO_PACK_CODE;
+    if((p->code[a]&OCTO_CODE_OP)&&(n==0x1||n==0x2||n==0xB)){k[t]|=OCTO_PACK_RUN;continue;}
+    int set=((p->code[a]&OCTO_CODE_OP)&&n==0xA)||(a>=2&&(p->code[a-2]&OCTO_CODE_OP)&&octo_opt_op(p,a-2)==0xF000);
+    if(set){
+      int e=t+1;
+      while(e<p->length&&!(o->f[e]&OCTO_OPT_LABEL)&&!(p->code[e]&OCTO_CODE_ORG)&&!(k[e]&OCTO_PACK_CODE))e++;
+      written=octo_opt_pack_scan(o,a+2,0,0,seen,++stamp,-1,0,planes)==1;
+      if(octo_opt_pack_scan(o,a+2,0,0,seen,++stamp,e-t,0,planes)==1)k[t]|=OCTO_PACK_SPANNED;
+    }
+    if(written)k[t]|=OCTO_PACK_WRITTEN;
+  }
+  for(int z=0;z<p->monitors.values.count;z++){
+    octo_mon*m=octo_list_get(&p->monitors.values,z);
+    if(m->type==1)k[m->base&0xFFFF]|=OCTO_PACK_WRITTEN;
+  }
+  for(int z=0;z<p->watches.count;z++)k[((octo_watch*)octo_list_get(&p->watches,z))->base&0xFFFF]|=OCTO_PACK_WRITTEN;
+  // a write, or a read which runs past its label, may go on to the end of the data
+  for(int a=1;a<p->length;a++)if(!(k[a]&OCTO_PACK_CODE))k[a]|=k[a-1]&(OCTO_PACK_WRITTEN|OCTO_PACK_SPANNED);
+
+  // the regions which may be packed, from the largest down
+  octo_pack_region*r=malloc((p->label_count+1)*sizeof(octo_pack_region));
+  int count=0;
+  for(int z=0;z<p->label_count;z++){
+    int a=p->labels[z].value, e=a+1;
+    if(a<0x200||a>=p->length||(z>0&&p->labels[z-1].value==a))continue;
+    while(e<p->length&&!(o->f[e]&OCTO_OPT_LABEL)&&!(p->code[e]&OCTO_CODE_ORG))e++;
+    int ok=1;
+    for(int b=a;b<e&&ok;b++)ok=p->used[b]&&!(k[b]&(OCTO_PACK_CODE|OCTO_PACK_RUN|OCTO_PACK_WRITTEN|OCTO_PACK_SPANNED))&&!(o->f[b]&OCTO_OPT_DEAD);
+    if(ok)r[count].a=a, r[count].e=e, r[count].index=p->labels[z].index, count++;
+  }
+  char*data=calloc(OCTO_RAM_MAX,1);
+  for(int z=0;z<count;z++)memset(data+r[z].a,1,r[z].e-r[z].a);
+  #define octo_pack_live(b) (data[b]&&!(o->f[b]&OCTO_OPT_DEAD))
+  #define octo_pack_drop(b,c) (o->f[b]|=OCTO_OPT_DEAD, o->fwd[b]=(c), k[c]|=OCTO_PACK_HOST)
+
+  // a label whose bytes are found elsewhere moves there
+  qsort(r,count,sizeof(octo_pack_region),octo_pack_region_cmp);
+  for(int z=0;z<count;z++){
+    int a=r[z].a, n=r[z].e-a, h=-1;
+    for(int b=a;b<a+n;b++)if(k[b]&OCTO_PACK_HOST)n=0;
+    for(int c=0x200;n>0&&c+n<=p->length&&h<0;c++){
+      if(c+n>a&&c<a+n)continue;
+      if(memcmp(p->rom+c,p->rom+a,n))continue;
+      h=c;
+      for(int b=c;b<c+n;b++)if(!octo_pack_live(b))h=-1;
+    }
+    if(h<0)continue;
+    for(int b=0;b<n;b++)octo_pack_drop(a+b,h+b);
+    o->s->saved[r[z].index]+=n, o->s->packed+=n;
+  }
+  // a label whose data begins as the data before it ends overlaps it
+  for(int a=0x201;a<p->length;a++){
+    if(!(o->f[a]&OCTO_OPT_LABEL)||!octo_pack_live(a)||!octo_pack_live(a-1))continue;
+    int z=0, e=a, best=0;
+    while(z<count&&r[z].a!=a)z++;
+    while(e<p->length&&octo_pack_live(e)&&!(k[e]&OCTO_PACK_HOST)&&(e==a||!(o->f[e]&OCTO_OPT_LABEL)))e++;
+    for(int n=1;n<e-a&&a-n>=0x200&&octo_pack_live(a-n);n++)if(!memcmp(p->rom+a-n,p->rom+a,n))best=n;
+    for(int b=0;b<best;b++)octo_pack_drop(a+b,a-best+b);
+    if(z<count)o->s->saved[r[z].index]+=best;
+    o->s->packed+=best;
+  }
+  o->s->bytes+=o->s->packed;
+  #undef octo_pack_live
+  #undef octo_pack_drop
+  free(data), free(r), free(seen), free(k);
+}
+
+/**
+*
+*  Relocation
+*
+*  each segment of the rom (begun by :org, or at 0x200)
+*  closes up over the bytes removed from it, leaving the
+*  space at its end unused. addresses past the end of the
+*  rom stay where they are, and packed bytes move with
+*  their copies.
+*
+**/
+
+void octo_opt_compact(octo_opt*o){
+  octo_program*p=o->p;
+  int*to=malloc(OCTO_RAM_MAX*sizeof(int)), shift=0;
+  for(int a=0;a<OCTO_RAM_MAX;a++){
+    if(p->code[a]&OCTO_CODE_ORG)shift=0;
+    to[a]=a<p->length?a-shift:a;
+    if(o->f[a]&OCTO_OPT_DEAD)shift++;
+  }
+  for(int a=0;a<OCTO_RAM_MAX;a++)if(o->fwd[a]>=0)to[a]=to[o->fwd[a]];
+  char*rom=calloc(OCTO_RAM_MAX,1), *used=calloc(OCTO_RAM_MAX,1), *code=calloc(OCTO_RAM_MAX,1);
+  for(int a=0;a<OCTO_RAM_MAX;a++){
+    if(o->f[a]&OCTO_OPT_DEAD)continue;
+    if(p->used[a])rom[to[a]]=p->rom[a], used[to[a]]=1;
+    code[to[a]]|=p->code[a];
+  }
+  memcpy(p->rom,rom,OCTO_RAM_MAX), memcpy(p->used,used,OCTO_RAM_MAX), memcpy(p->code,code,OCTO_RAM_MAX);
+  free(rom), free(used), free(code);
+  for(int a=0;a<OCTO_RAM_MAX;a++)if(p->code[a]&OCTO_CODE_ADDR)octo_opt_set_field(p,a,to[octo_opt_field(p,a)]);
+
+  for(int z=0;z<p->constants.keys.count;z++){
+    octo_const*c=octo_list_get(&p->constants.values,z);
+    if(c->is_label==1&&c->value>=0&&c->value<OCTO_RAM_MAX)c->value=to[(int)c->value];
+  }
+  for(int z=0;z<p->label_count;z++)p->labels[z].value=((octo_const*)octo_list_get(&p->constants.values,p->labels[z].index))->value;
+  qsort(p->labels,p->label_count,sizeof(octo_label),octo_label_cmp);
+  memset(p->breakpoints,0,sizeof(p->breakpoints));
+  for(int z=0;z<p->breaks.count;z++){
+    octo_break*b=octo_list_get(&p->breaks,z);
+    b->addr=to[b->addr], p->breakpoints[b->addr>>3]|=1<<(b->addr&7);
+  }
+  for(int z=0;z<p->monitors.values.count;z++){
+    octo_mon*m=octo_list_get(&p->monitors.values,z);
+    if(m->type==1)m->base=to[m->base&0xFFFF];
+  }
+  for(int z=0;z<p->watches.count;z++){
+    octo_watch*w=octo_list_get(&p->watches,z);
+    w->base=to[w->base&0xFFFF];
+  }
+  while(p->length>0x200&&!p->used[p->length-1])p->length--;
+  free(to);
+}
+
+void octo_optimize(octo_program*p,octo_opt_stats*s,int passes){
+  // run the given OCTO_PASS_ passes over p.
+  memset(s,0,sizeof(octo_opt_stats));
+  if(p->is_error)return;
+  octo_opt o;
+  octo_opt_init(&o,p,s);
+  if(passes&OCTO_PASS_PEEPHOLE)octo_opt_tails(&o), octo_opt_threads(&o), octo_opt_blocks(&o);
+  if(passes&OCTO_PASS_PRUNE   )octo_opt_prune(&o);
+  if(passes&OCTO_PASS_PACK    )octo_opt_pack(&o);
+  if(s->bytes)octo_opt_compact(&o);
+  octo_opt_destroy(&o);
+}
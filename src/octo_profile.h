@@ -0,0 +1,181 @@
+/**
+*
+*  octo_profile.h
+*
+*  reports for an octo_profile collected by the emulator
+*  core: a flat profile of cycles per label, executions
+*  per opcode class and ticks per subroutine, and a
+*  collapsed-stack file suitable for flamegraph tools.
+*  addresses are resolved to the nearest constant at or
+*  below them, as the debugger does.
+*
+**/
+
+typedef struct {
+  char*    name;
+  uint64_t cycles;
+  uint64_t count;
+} octo_profile_row;
+
+typedef struct {
+  uint16_t addr;
+  uint32_t calls;
+  uint64_t inclusive;
+  uint64_t exclusive;
+} octo_profile_call;
+
+#define OCTO_PROFILE_BY_INCLUSIVE 1
+#define OCTO_PROFILE_BY_EXCLUSIVE 2
+#define OCTO_PROFILE_BY_CALLS     3
+
+int octo_profile_row_cmp(const void*a,const void*b){
+  const octo_profile_row*x=a, *y=b;
+  if(x->cycles!=y->cycles)return x->cycles>y->cycles?-1:1;
+  return strcmp(x->name,y->name);
+}
+
+int octo_profile_name_cmp(const void*a,const void*b){
+  return strcmp(((const octo_profile_row*)a)->name,((const octo_profile_row*)b)->name);
+}
+
+#define OCTO_PROFILE_CMP(field) \
+  int octo_profile_call_##field(const void*a,const void*b){ \
+    const octo_profile_call*x=a, *y=b; \
+    if(x->field!=y->field)return x->field>y->field?-1:1; \
+    return x->addr-y->addr; \
+  }
+OCTO_PROFILE_CMP(inclusive)
+OCTO_PROFILE_CMP(exclusive)
+OCTO_PROFILE_CMP(calls)
+
+int octo_profile_calls(octo_profile*p,octo_emulator*e,octo_profile_call*rows,int sort){
+  // ticks per subroutine, sorted by the given OCTO_PROFILE_BY_ column.
+  // if e is provided, subroutines still on its stack are charged up to now.
+  // rows must have room for 4096 entries.
+  int n=0, open=e&&e->profile==p?e->rp:0;
+  if(open>16)open=16;
+  for(int a=0;a<4*1024;a++){
+    uint64_t in=p->inclusive[a], ex=p->exclusive[a];
+    for(int d=0;d<open;d++)if(p->target[d]==a){
+      long t=e->ticks-p->entry[d], inner=d+1<open?e->ticks-p->entry[d+1]:0;
+      in+=t, ex+=t-p->nested[d]-inner;
+    }
+    if(p->calls[a]||in)rows[n].addr=a, rows[n].calls=p->calls[a], rows[n].inclusive=in, rows[n].exclusive=ex, n++;
+  }
+  qsort(rows,n,sizeof(octo_profile_call),
+    sort==OCTO_PROFILE_BY_CALLS    ?octo_profile_call_calls:
+    sort==OCTO_PROFILE_BY_EXCLUSIVE?octo_profile_call_exclusive:octo_profile_call_inclusive);
+  return n;
+}
+
+char** octo_profile_labels(octo_program*prog){
+  // the name of every address, as given by octo_label_near(). names for unknown addresses are NULL.
+  char**labels=calloc(64*1024,sizeof(char*));
+  for(int a=0,offset;prog&&a<64*1024;a++)labels[a]=octo_label_near(prog,a,&offset);
+  return labels;
+}
+
+char* octo_profile_label(char**labels,uint16_t addr,char*buffer,int len){
+  if(labels[addr])return labels[addr];
+  snprintf(buffer,len,"0x%04X",addr);
+  return buffer;
+}
+
+/**
+*
+*  Flat Profile
+*
+**/
+
+void octo_profile_write(octo_profile*p,octo_emulator*e,octo_program*prog,FILE*out){
+  static const char*classes[]={
+    "0NNN machine/screen","1NNN jump","2NNN call","3XNN skip if ==","4XNN skip if !=",
+    "5XY_ compare/save/load range","6XNN load","7XNN add","8XY_ arithmetic","9XY0 skip if !=",
+    "ANNN load i","BNNN jump0","CXNN random","DXYN sprite","EX__ keys","FX__ misc",
+  };
+  char**labels=octo_profile_labels(prog);
+  octo_profile_row*rows=calloc(64*1024,sizeof(octo_profile_row));
+  char(*names)[8]=malloc(64*1024*8);
+  int n=0;
+  uint64_t total=0, count=0;
+  for(int a=0;a<64*1024;a++){
+    if(!p->cycles[a]&&!p->count[a])continue;
+    rows[n].name=octo_profile_label(labels,a,names[n],sizeof(names[n]));
+    rows[n].cycles=p->cycles[a], rows[n].count=p->count[a], n++;
+    total+=p->cycles[a], count+=p->count[a];
+  }
+  // merge the addresses under each label
+  qsort(rows,n,sizeof(octo_profile_row),octo_profile_name_cmp);
+  int m=0;
+  for(int z=0;z<n;z++){
+    if(m>0&&!strcmp(rows[m-1].name,rows[z].name)){rows[m-1].cycles+=rows[z].cycles,rows[m-1].count+=rows[z].count;continue;}
+    rows[m++]=rows[z];
+  }
+  qsort(rows,m,sizeof(octo_profile_row),octo_profile_row_cmp);
+  fprintf(out,"# %llu cycles, %llu instructions executed\n",(unsigned long long)total,(unsigned long long)count);
+  fprintf(out,"#\n#       cycles        %%    executions  label\n");
+  for(int z=0;z<m;z++)fprintf(out,"%14llu  %6.2f%%  %12llu  %s\n",
+    (unsigned long long)rows[z].cycles,total?100.0*rows[z].cycles/total:0,(unsigned long long)rows[z].count,rows[z].name);
+  fprintf(out,"#\n#   executions        %%  opcode class\n");
+  for(int z=0;z<16;z++)if(p->classes[z])fprintf(out,"%14llu  %6.2f%%  %s\n",
+    (unsigned long long)p->classes[z],count?100.0*p->classes[z]/count:0,classes[z]);
+  octo_profile_call*calls=malloc(4*1024*sizeof(octo_profile_call));
+  int c=octo_profile_calls(p,e,calls,OCTO_PROFILE_BY_INCLUSIVE);
+  if(c)fprintf(out,"#\n#    inclusive       %%     exclusive         calls  subroutine\n");
+  for(int z=0;z<c;z++)fprintf(out,"%14llu  %6.2f%%  %12llu  %12lu  %s\n",
+    (unsigned long long)calls[z].inclusive,total?100.0*calls[z].inclusive/total:0,(unsigned long long)calls[z].exclusive,
+    (unsigned long)calls[z].calls,octo_profile_label(labels,calls[z].addr,names[0],sizeof(names[0])));
+  if(p->dropped)fprintf(out,"#\n# %llu cycles in call stacks which did not fit the profile\n",(unsigned long long)p->dropped);
+  free(calls);
+  free(names);
+  free(rows);
+  free(labels);
+}
+
+/**
+*
+*  Collapsed Stacks
+*
+*  one line per distinct stack of labels, outermost first,
+*  followed by its cycles. callers are named by their call
+*  instruction, just before each return address.
+*
+**/
+
+void octo_profile_write_folded(octo_profile*p,octo_program*prog,FILE*out){
+  char**labels=octo_profile_labels(prog);
+  octo_profile_row*rows=calloc(OCTO_PROFILE_STACKS,sizeof(octo_profile_row));
+  int n=0;
+  for(int z=0;z<OCTO_PROFILE_STACKS;z++){
+    octo_profile_stack*s=&p->stacks[z];
+    if(s->depth==0)continue;
+    char line[OCTO_PROFILE_DEPTH*256]="", buffer[8];
+    int len=0;
+    for(int d=0;d<s->depth;d++){
+      uint16_t a=d<s->depth-1?s->addr[d]-2:s->addr[d];
+      len+=snprintf(line+len,sizeof(line)-len,"%s%s",d?";":"",octo_profile_label(labels,a,buffer,sizeof(buffer)));
+      if(len>=(int)sizeof(line))len=sizeof(line)-1;
+    }
+    rows[n].name=strcpy(malloc(len+1),line), rows[n].cycles=s->cycles, n++;
+  }
+  qsort(rows,n,sizeof(octo_profile_row),octo_profile_name_cmp);
+  for(int z=0;z<n;z++){
+    uint64_t cycles=rows[z].cycles;
+    while(z+1<n&&!strcmp(rows[z].name,rows[z+1].name))free(rows[z].name),cycles+=rows[++z].cycles;
+    fprintf(out,"%s %llu\n",rows[z].name,(unsigned long long)cycles);
+    free(rows[z].name);
+  }
+  free(rows);
+  free(labels);
+}
+
+int octo_profile_save(octo_profile*p,octo_emulator*e,octo_program*prog,char*path){
+  // write the flat profile to path and collapsed stacks to path.folded
+  char folded[4096];
+  snprintf(folded,sizeof(folded),"%s.folded",path);
+  FILE*flat=fopen(path,"w"), *stacks=fopen(folded,"w");
+  if(flat  )octo_profile_write       (p,e,prog,flat),fclose(flat  );
+  if(stacks)octo_profile_write_folded(p,prog,stacks),fclose(stacks);
+  if(!flat||!stacks)fprintf(stderr,"unable to write profile %s\n",flat?folded:path);
+  return flat&&stacks;
+}
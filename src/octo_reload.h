@@ -0,0 +1,164 @@
+/**
+*
+*  octo_reload.h
+*
+*  the channel over which octo-cli -w hands freshly compiled
+*  roms to a running octo-run -r. octo-run listens on a unix
+*  socket, $XDG_RUNTIME_DIR/octo-run.sock (or
+*  /tmp/octo-run-<uid>.sock), and each connection carries a
+*  whole program before it is closed:
+*
+*    "octorld1"   magic
+*    bytes        the rom, from 0x200 up
+*
+*  the socket is only writable by its owner, and both ends
+*  check that the other runs as the same user. the listener
+*  never blocks: a message is gathered over as many calls to
+*  octo_reload_receive() as it takes to arrive, and one which
+*  is too large or takes too long is dropped.
+*
+*  where unix sockets are unavailable, nothing is sent and
+*  nothing is ever received.
+*
+**/
+
+#define OCTO_RELOAD_MAX     (65536-0x200)
+#define OCTO_RELOAD_TIMEOUT 5 // seconds a sender may take to finish a message
+
+#if !defined(_WIN32)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <asm/socket.h> // SO_PEERCRED, which strict c99 hides
+#endif
+#define OCTO_RELOAD_SOCKETS
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+typedef struct {
+  int      fd;       // listening socket, or -1
+  int      client;   // connection being read, or -1
+  int      size;     // bytes read from client, magic included
+  time_t   started;  // when client connected
+  uint64_t dev, ino; // identity of the socket file this process bound
+  char     buffer[8+OCTO_RELOAD_MAX+1];
+} octo_reload;
+
+#ifdef OCTO_RELOAD_SOCKETS
+void octo_reload_address(struct sockaddr_un*a){
+  char*dir=getenv("XDG_RUNTIME_DIR");
+  memset(a,0,sizeof(struct sockaddr_un));
+  a->sun_family=AF_UNIX;
+  if(dir&&dir[0])snprintf(a->sun_path,sizeof(a->sun_path),"%s/octo-run.sock",dir);
+  else           snprintf(a->sun_path,sizeof(a->sun_path),"/tmp/octo-run-%ld.sock",(long)getuid());
+}
+int octo_reload_peer(int fd){
+  // is the other end of fd run by this user? without a way to ask, the socket's permissions must do.
+#if defined(__linux__)
+  struct {pid_t pid; uid_t uid; gid_t gid;} cred; // struct ucred
+  socklen_t n=sizeof(cred);
+  return !getsockopt(fd,SOL_SOCKET,SO_PEERCRED,&cred,&n)&&cred.uid==getuid();
+#elif defined(__APPLE__)||defined(__FreeBSD__)||defined(__OpenBSD__)||defined(__NetBSD__)
+  uid_t uid; gid_t gid;
+  return !getpeereid(fd,&uid,&gid)&&uid==getuid();
+#else
+  (void)fd;
+  return 1;
+#endif
+}
+#endif
+
+int octo_reload_listen(octo_reload*r){
+  // open a nonblocking socket for octo_reload_receive(). a previous listener is displaced.
+  r->fd=r->client=-1, r->size=0;
+#ifdef OCTO_RELOAD_SOCKETS
+  struct sockaddr_un a;
+  struct stat st;
+  octo_reload_address(&a);
+  int fd=socket(AF_UNIX,SOCK_STREAM,0);
+  if(fd<0)return 0;
+  unlink(a.sun_path);
+  // nobody can connect before listen(), so the socket is never open to others
+  if(bind(fd,(struct sockaddr*)&a,sizeof(a))||chmod(a.sun_path,0600)||stat(a.sun_path,&st)||
+     listen(fd,4)||fcntl(fd,F_SETFL,O_NONBLOCK)){close(fd);return 0;}
+  r->fd=fd, r->dev=st.st_dev, r->ino=st.st_ino;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void octo_reload_drop(octo_reload*r){
+#ifdef OCTO_RELOAD_SOCKETS
+  if(r->client>=0)close(r->client);
+#endif
+  r->client=-1, r->size=0;
+}
+void octo_reload_close(octo_reload*r){
+  // the socket file is left alone if a newer listener has since replaced it
+  octo_reload_drop(r);
+#ifdef OCTO_RELOAD_SOCKETS
+  struct sockaddr_un a;
+  struct stat st;
+  octo_reload_address(&a);
+  if(r->fd>=0&&!stat(a.sun_path,&st)&&(uint64_t)st.st_dev==r->dev&&(uint64_t)st.st_ino==r->ino)unlink(a.sun_path);
+  if(r->fd>=0)close(r->fd);
+#endif
+  r->fd=-1;
+}
+
+int octo_reload_receive(octo_reload*r,char*rom,int*size){
+  // the newest rom to have arrived in full, if any. rom must hold OCTO_RELOAD_MAX bytes.
+  int got=0;
+#ifdef OCTO_RELOAD_SOCKETS
+  while(r->fd>=0){
+    if(r->client<0){
+      int c=accept(r->fd,NULL,NULL);
+      if(c<0)break;
+      if(!octo_reload_peer(c)||fcntl(c,F_SETFL,O_NONBLOCK)){close(c);continue;}
+      r->client=c, r->size=0, r->started=time(NULL);
+    }
+    int k;
+    while((k=read(r->client,r->buffer+r->size,sizeof(r->buffer)-r->size))>0&&(r->size+=k)<(int)sizeof(r->buffer));
+    if(r->size>8+OCTO_RELOAD_MAX||(r->size>=8&&memcmp(r->buffer,"octorld1",8))){octo_reload_drop(r);continue;}
+    if(k==0){
+      if(r->size>=8)memcpy(rom,r->buffer+8,r->size-8), *size=r->size-8, got=1;
+      octo_reload_drop(r);
+      continue;
+    }
+    if(errno==EINTR)continue;
+    if((errno!=EAGAIN&&errno!=EWOULDBLOCK)||time(NULL)-r->started>OCTO_RELOAD_TIMEOUT){octo_reload_drop(r);continue;}
+    break; // the rest has yet to arrive
+  }
+#else
+  (void)r, (void)rom, (void)size;
+#endif
+  return got;
+}
+
+int octo_reload_send(char*rom,int size){
+  // 1 if an octo-run was listening, 0 if not, -1 if this platform has no sockets.
+#ifdef OCTO_RELOAD_SOCKETS
+  struct sockaddr_un a;
+  octo_reload_address(&a);
+  int fd=socket(AF_UNIX,SOCK_STREAM,0), sent=0;
+  if(fd<0)return 0;
+  if(size>=0&&size<=OCTO_RELOAD_MAX&&!connect(fd,(struct sockaddr*)&a,sizeof(a))&&octo_reload_peer(fd)){
+    sent=send(fd,"octorld1",8,MSG_NOSIGNAL)==8;
+    for(int n=0,k;sent&&n<size;n+=k)if((k=send(fd,rom+n,size-n,MSG_NOSIGNAL))<=0)sent=0;
+  }
+  close(fd);
+  return sent;
+#else
+  (void)rom, (void)size;
+  return -1;
+#endif
+}
@@ -12,36 +12,100 @@
 *   i - interrupt/resume
 *   o - single step (while interrupted)
 *   m - toggle monitor display
+*   p - cycle the subroutine profile display
+*   h - toggle the frame budget histogram
 *  ^f - toggle fullscreen mode
 *
 *  esc or ` exits the program.
 *
+*  with -p, execution is profiled and a report
+*  is written when the program exits. with -f,
+*  the per-frame counters shown by the histogram
+*  are written to a CSV file as the program runs.
+*  with -t, the last instructions executed are
+*  written to a file whenever the program halts,
+*  which can be decoded with octo-cli -t.
+*
+*  with -r, octo-run listens for new builds sent by
+*  octo-cli -w and swaps each one into the running
+*  emulator. with -k as well, the registers and the
+*  ram beyond the new rom survive the swap.
+*
 **/
 
 #include "octo_emulator.h"
 #include "octo_compiler.h"
 #include "octo_cartridge.h"
+#include "octo_profile.h"
+#include "octo_trace.h"
 #include <SDL.h>
 #include "octo_util.h"
+#include "octo_reload.h"
 
 octo_program* prog=NULL;
 octo_emulator emu;
+octo_reload listener={.fd=-1,.client=-1};
+
+void reload(char*rom,int size,int keep){
+  // the new build arrives without its symbols, so monitors and labels are dropped
+  static octo_emulator old;
+  memcpy(&old,&emu,sizeof(octo_emulator));
+  octo_emulator_init(&emu,rom,size,&old.options,(char*)old.flags);
+  if(keep){
+    memcpy(emu.v,old.v,sizeof(emu.v)), emu.i=old.i, emu.dt=old.dt, emu.st=old.st;
+    memcpy(emu.ram+0x200+size,old.ram+0x200+size,sizeof(emu.ram)-0x200-size);
+  }
+  octo_emulator_profile(&emu,old.profile);
+  octo_emulator_trace(&emu,old.trace);
+  if(prog)octo_free_program(prog),prog=NULL;
+  octo_ui_invalidate(&emu);
+}
 
 int main(int argc, char* argv[]){
-  char*source_path=NULL,*options_path=NULL;
+  char*source_path=NULL,*options_path=NULL,*profile_path=NULL,*stats_path=NULL,*trace_path=NULL;
+  int listening=0, keep=0;
   for(int z=1;z<argc;z++){
     if(strcmp(argv[z],"-c")==0){
       if(z+1>=argc){printf("no config file path specified for -c.\n");return 1;}
       options_path=argv[++z];
     }
+    else if(strcmp(argv[z],"-p")==0){
+      if(z+1>=argc){printf("no profile path specified for -p.\n");return 1;}
+      profile_path=argv[++z];
+    }
+    else if(strcmp(argv[z],"-f")==0){
+      if(z+1>=argc){printf("no frame statistics path specified for -f.\n");return 1;}
+      stats_path=argv[++z];
+    }
+    else if(strcmp(argv[z],"-t")==0){
+      if(z+1>=argc){printf("no trace path specified for -t.\n");return 1;}
+      trace_path=argv[++z];
+    }
+    else if(strcmp(argv[z],"-r")==0||strcmp(argv[z],"--reload")==0){listening=1;}
+    else if(strcmp(argv[z],"-k")==0){keep=1;}
     else{source_path=argv[z];}
   }
   if(source_path==NULL){
     printf("octo-run v%s\n",VERSION);
-    printf("usage: %s <source> [-c <path>]\nwhere <source> is a .ch8 or .8o\n-c : specify a path to an override config file.\n",argv[0]);
+    printf("usage: %s <source> [-c <path>] [-p <path>] [-f <path>] [-t <path>] [-r [-k]]\nwhere <source> is a .ch8 or .8o\n-c : specify a path to an override config file.\n",argv[0]);
+    printf("-p : profile the program, writing a flat profile to <path> and collapsed stacks to <path>.folded on exit.\n");
+    printf("-f : write per-frame instruction, sprite and collision counts to <path> as CSV.\n");
+    printf("-t : write the last instructions executed to <path>, rather than the cache directory, when the program halts.\n");
+    printf("-r : swap in new builds of the program sent by octo-cli -w.\n");
+    printf("-k : with -r, keep the registers and the ram beyond the new rom across a swap.\n");
     return 0;
   }
   octo_load_program(&ui,&emu,&prog,source_path,options_path);
+  octo_profile*profile=NULL;
+  if(profile_path)profile=calloc(1,sizeof(octo_profile)),octo_emulator_profile(&emu,profile);
+  // the trace is always kept; without -t, a halt writes it to the cache directory
+  octo_trace*trace=calloc(1,sizeof(octo_trace));
+  octo_emulator_trace(&emu,trace);
+  static char cached_trace[OCTO_PATH_MAX];
+  int announce=trace_path==NULL;
+  if(trace_path==NULL&&octo_cache_dir(cached_trace))octo_path_append(cached_trace,"octo-run.trace"),trace_path=cached_trace;
+  if(listening&&!octo_reload_listen(&listener))fprintf(stderr,"unable to listen for reloads.\n");
+  if(stats_path&&(ui_stats_csv=fopen(stats_path,"w"))==NULL){fprintf(stderr,"unable to write frame statistics %s\n",stats_path);return 1;}
 
   SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK | SDL_INIT_AUDIO);
   SDL_Window  *win=SDL_CreateWindow("Octo-Run",SDL_WINDOWPOS_CENTERED,SDL_WINDOWPOS_CENTERED,ui.win_width*ui.win_scale,ui.win_height*ui.win_scale,SDL_WINDOW_SHOWN);
@@ -62,6 +126,7 @@ int main(int argc, char* argv[]){
     if(e.type==SDL_RENDER_DEVICE_RESET||e.type==SDL_RENDER_TARGETS_RESET){
       SDL_DestroyTexture(overlay),overlay=NULL;
       octo_ui_init(win,&ren,&screen);
+      octo_ui_invalidate(&emu);
     }
     events_joystick(&emu,&joy,&e);
     if(e.type==SDL_KEYDOWN){
@@ -76,6 +141,8 @@ int main(int argc, char* argv[]){
       }
       if(code==SDLK_ESCAPE||code==SDLK_BACKQUOTE)break;
       if(code==SDLK_m)ui.show_monitors=!ui.show_monitors,octo_ui_invalidate(&emu);
+      if(code==SDLK_p)ui.show_profile=(ui.show_profile+1)%4,octo_ui_invalidate(&emu);
+      if(code==SDLK_h)ui.show_stats=!ui.show_stats,octo_ui_invalidate(&emu);
       if(emu.halt){
         if(code==SDLK_i)emu.halt=0,octo_ui_invalidate(&emu);
         if(code==SDLK_o){emu.dt=emu.st=0;octo_emulator_instruction(&emu);snprintf(emu.halt_message,OCTO_HALT_MAX,"Single Stepping");}
@@ -89,7 +156,12 @@ int main(int argc, char* argv[]){
       }
     }
     if(e.type==SDL_USEREVENT){
+      static char rom[OCTO_RELOAD_MAX];
+      int size;
+      if(octo_reload_receive(&listener,rom,&size))reload(rom,size,keep);
+      int was_halted=emu.halt;
       emu_step(&emu,prog);
+      if(trace_path&&emu.halt&&!was_halted&&octo_trace_save(trace,&emu,trace_path)&&announce)fprintf(stderr,"last instructions written to %s\n",trace_path);
       SDL_FlushEvent(SDL_USEREVENT); // don't queue up repaints if we're running slow!
 
       int bgcolor=emu.options.colors[emu.st>0?OCTO_COLOR_SOUND: OCTO_COLOR_BACKGROUND];
@@ -107,5 +179,8 @@ int main(int argc, char* argv[]){
     }
   }
   SDL_Quit();
+  octo_reload_close(&listener);
+  if(ui_stats_csv)fclose(ui_stats_csv);
+  if(profile&&!octo_profile_save(profile,&emu,prog,profile_path))return 1;
   return 0;
 }
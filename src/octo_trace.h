@@ -0,0 +1,295 @@
+/**
+*
+*  octo_trace.h
+*
+*  saving, loading and decoding the instruction trace
+*  kept by the emulator core. a trace file is a small
+*  header followed by records, oldest first:
+*
+*    "octotrc2"                   magic
+*    u64  instructions traced in total
+*    u32  records which follow
+*    u32  length of the halt message, then its bytes
+*    records of u16 pc, u16 op, u16 i, u8 vx, u8 vf, u8 known
+*
+*  all fields are little-endian. i is as it stood before the
+*  instruction, and vx and vf as they stood after it; known
+*  has OCTO_TRACE_I, OCTO_TRACE_VX and OCTO_TRACE_VF set for
+*  those of them which could be rebuilt.
+*
+**/
+
+#define OCTO_TRACE_I  0x01
+#define OCTO_TRACE_VX 0x02
+#define OCTO_TRACE_VF 0x04
+
+typedef struct {
+  uint16_t pc, op, i;
+  uint8_t  vx, vf, known;
+} octo_trace_entry;
+
+typedef struct {
+  uint64_t count;              // instructions traced in total
+  int      length;             // records kept
+  octo_trace_entry*entries;    // oldest first
+  char     message[OCTO_HALT_MAX];
+} octo_trace_file;
+
+/**
+*
+*  Replay
+*
+*  the ring holds only the pc and opcode of each instruction,
+*  so the registers are rebuilt by replaying the instructions
+*  from the registers of a mark, with the quirks the emulator
+*  ran under. each value is tracked along with whether it is
+*  known: those which came from the delay timer, the keys, a
+*  sprite's collisions or rand() are not. a load is known if
+*  it reads a byte written earlier in the replay, or one which
+*  nothing in the replay writes, as the emulator's ram still
+*  holds it. which bytes the replay writes depends on what
+*  it loads, so it is run again until that set stops growing;
+*  a write through an unknown i makes every such byte unknown.
+*
+**/
+
+typedef struct {
+  uint8_t  v[16], flags[16];
+  uint16_t vk, fk;      // which of v and flags are known
+  uint16_t i;
+  char     ik, sk;      // is i known? is the seed?
+  uint32_t seed;
+  uint8_t* ram;         // the emulator's ram, as the trace ended
+  uint8_t* mem;         // bytes written so far
+  char*    written;     // 0: not written so far, 1: written a known value, 2: an unknown one
+  char*    later;       // may be written at some point in the replay
+  char     wild;        // there was a write through an unknown i
+  char     grew;        // this pass added to later, or set wild
+} octo_trace_replay;
+
+int octo_trace_read(octo_trace_replay*r,int offset,uint8_t*v){
+  // 1 if the byte at i+offset is known, which is then stored in v
+  int a=(r->i+offset)&0xFFFF;
+  if(!r->ik||r->written[a]==2)return 0;
+  if(r->written[a]==1){*v=r->mem[a];return 1;}
+  if(r->wild||r->later[a])return 0;
+  *v=r->ram[a];
+  return 1;
+}
+void octo_trace_write_byte(octo_trace_replay*r,int offset,uint8_t v,int known){
+  if(!r->ik){r->grew|=!r->wild, r->wild=1;return;}
+  int a=(r->i+offset)&0xFFFF;
+  r->grew|=!r->later[a], r->later[a]=1, r->written[a]=known?1:2, r->mem[a]=v;
+}
+void octo_trace_set(octo_trace_replay*r,int x,uint8_t v,int known){
+  r->v[x]=v;
+  if(known)r->vk|=1<<x; else r->vk&=~(1<<x);
+}
+#define octo_trace_known(r,x) (((r)->vk>>(x))&1)
+
+void octo_trace_step(octo_trace_replay*r,octo_options*q,uint16_t pc,uint16_t op){
+  int x=(op>>8)&0xF, y=(op>>4)&0xF, n=op&0xF, nn=op&0xFF, kx=octo_trace_known(r,x), ky=octo_trace_known(r,y), t;
+  uint8_t vx=r->v[x], vy=r->v[y], b;
+  if(op==0xF000){r->i=(r->ram[(uint16_t)(pc+2)]<<8)|r->ram[(uint16_t)(pc+3)], r->ik=1;return;}
+  if((op&0xF00F)==0x5002){for(int z=0;z<=abs(x-y);z++){int s=x<y?x+z:x-z;octo_trace_write_byte(r,z,r->v[s],octo_trace_known(r,s));}return;}
+  if((op&0xF00F)==0x5003){for(int z=0;z<=abs(x-y);z++){int k=octo_trace_read(r,z,&b);octo_trace_set(r,x<y?x+z:x-z,b,k);}return;}
+  switch(op>>12){
+    case 0x6: octo_trace_set(r,x,nn,1);      break;
+    case 0x7: octo_trace_set(r,x,vx+nn,kx);  break;
+    case 0x8:
+      switch(n){
+        case 0x0: octo_trace_set(r,x,vy,ky);                                          break;
+        case 0x1: octo_trace_set(r,x,vx|vy,kx&&ky); if(q->q_logic)octo_trace_set(r,15,0,1); break;
+        case 0x2: octo_trace_set(r,x,vx&vy,kx&&ky); if(q->q_logic)octo_trace_set(r,15,0,1); break;
+        case 0x3: octo_trace_set(r,x,vx^vy,kx&&ky); if(q->q_logic)octo_trace_set(r,15,0,1); break;
+        case 0x4: t=vx+vy, octo_trace_set(r,x,t,kx&&ky), octo_trace_set(r,15,t>0xFF,kx&&ky);      break;
+        case 0x5: octo_trace_set(r,x,vx-vy,kx&&ky), octo_trace_set(r,15,vx>=vy,kx&&ky);          break;
+        case 0x7: octo_trace_set(r,x,vy-vx,kx&&ky), octo_trace_set(r,15,vy>=vx,kx&&ky);          break;
+        case 0x6: if(q->q_shift)vy=vx,ky=kx; octo_trace_set(r,x,vy>>1,ky), octo_trace_set(r,15,vy&1,ky);  break;
+        case 0xE: if(q->q_shift)vy=vx,ky=kx; octo_trace_set(r,x,vy<<1,ky), octo_trace_set(r,15,vy>>7,ky); break;
+      }
+      break;
+    case 0xA: r->i=op&0xFFF, r->ik=1; break;
+    case 0xC:
+      // a seeded emulator draws the same numbers again
+      if(r->sk)r->seed^=r->seed<<13, r->seed^=r->seed>>17, r->seed^=r->seed<<5;
+      octo_trace_set(r,x,(r->seed>>24)&nn,r->sk||nn==0);
+      break;
+    case 0xD: octo_trace_set(r,15,0,0); break;
+    case 0xF: switch(nn){
+      case 0x07: case 0x0A: octo_trace_set(r,x,0,0); break;
+      case 0x1E: r->i+=vx, r->ik&=kx;                 break;
+      case 0x29: r->i= 5*(vx&0xF),      r->ik=kx;     break;
+      case 0x30: r->i=10*(vx&0xF)+5*16, r->ik=kx;     break;
+      case 0x33: octo_trace_write_byte(r,0,(vx/100)%10,kx), octo_trace_write_byte(r,1,(vx/10)%10,kx), octo_trace_write_byte(r,2,vx%10,kx); break;
+      case 0x55:
+        for(int z=0;z<=x;z++)octo_trace_write_byte(r,z,r->v[z],octo_trace_known(r,z));
+        if(!q->q_loadstore)r->i+=x+1;
+        break;
+      case 0x65:
+        for(int z=0;z<=x;z++){int k=octo_trace_read(r,z,&b);octo_trace_set(r,z,b,k);}
+        if(!q->q_loadstore)r->i+=x+1;
+        break;
+      case 0x75:
+        for(int z=0;z<=x;z++){r->flags[z]=r->v[z]; if(octo_trace_known(r,z))r->fk|=1<<z; else r->fk&=~(1<<z);}
+        break;
+      case 0x85: for(int z=0;z<=x;z++)octo_trace_set(r,z,r->flags[z],(r->fk>>z)&1); break;
+    }
+  }
+}
+
+int octo_trace_rebuild(octo_trace*t,octo_emulator*e,octo_trace_entry**entries){
+  // the records from the newest mark at least OCTO_TRACE_MARK instructions back, with their registers
+  uint64_t from=t->count>=OCTO_TRACE_MARK?(t->count-OCTO_TRACE_MARK)/OCTO_TRACE_MARK*OCTO_TRACE_MARK:0;
+  octo_trace_mark*m=&t->marks[(from/OCTO_TRACE_MARK)%OCTO_TRACE_MARKS];
+  if(from<t->attached.count||m->count!=from)m=&t->attached;
+  int n=t->count-m->count;
+  octo_trace_entry*r=*entries=malloc((n+1)*sizeof(octo_trace_entry));
+  octo_trace_replay p={0};
+  p.ram=e->ram, p.mem=malloc(OCTO_RAM_MAX), p.written=malloc(OCTO_RAM_MAX), p.later=calloc(OCTO_RAM_MAX,1);
+  for(int pass=0;;pass++){
+    memcpy(p.v,m->v,16), memcpy(p.flags,m->flags,16), p.vk=p.fk=0xFFFF;
+    p.i=m->i, p.ik=1, p.seed=m->seed, p.sk=m->seed!=0, p.grew=0;
+    memset(p.written,0,OCTO_RAM_MAX);
+    if(pass>=8)p.wild=1; // give up on the bytes the replay writes
+    char was=p.wild;
+    for(int z=0;z<n;z++){
+      uint32_t w=t->ring[(m->count+z)&(OCTO_TRACE_SIZE-1)];
+      uint16_t pc=w>>16, op=w, x=(op>>8)&0xF;
+      r[z].pc=pc, r[z].op=op, r[z].i=p.i, r[z].known=p.ik?OCTO_TRACE_I:0;
+      octo_trace_step(&p,&e->options,pc,op);
+      r[z].vx=p.v[x], r[z].vf=p.v[15];
+      r[z].known|=(octo_trace_known(&p,x)?OCTO_TRACE_VX:0)|(octo_trace_known(&p,15)?OCTO_TRACE_VF:0);
+    }
+    if(!p.grew||was)break;
+  }
+  free(p.mem), free(p.written), free(p.later);
+  return n;
+}
+#undef octo_trace_known
+
+void octo_trace_put(FILE*f,uint64_t v,int bytes){for(int z=0;z<bytes;z++)fputc((v>>(8*z))&0xFF,f);}
+uint64_t octo_trace_get(FILE*f,int bytes){
+  uint64_t v=0;
+  for(int z=0;z<bytes;z++){int c=fgetc(f);v|=(uint64_t)(c==EOF?0:c)<<(8*z);}
+  return v;
+}
+
+int octo_trace_save(octo_trace*t,octo_emulator*e,char*path){
+  FILE*f=fopen(path,"wb");
+  if(f==NULL){fprintf(stderr,"unable to write trace %s\n",path);return 0;}
+  octo_trace_entry*r;
+  int n=octo_trace_rebuild(t,e,&r), len=strlen(e->halt_message);
+  fwrite("octotrc2",1,8,f);
+  octo_trace_put(f,t->count,8), octo_trace_put(f,n,4), octo_trace_put(f,len,4);
+  fwrite(e->halt_message,1,len,f);
+  for(int z=0;z<n;z++){
+    octo_trace_put(f,r[z].pc,2), octo_trace_put(f,r[z].op,2), octo_trace_put(f,r[z].i,2);
+    octo_trace_put(f,r[z].vx,1), octo_trace_put(f,r[z].vf,1), octo_trace_put(f,r[z].known,1);
+  }
+  free(r);
+  fclose(f);
+  return 1;
+}
+
+int octo_trace_load(octo_trace_file*t,char*path){
+  FILE*f=fopen(path,"rb");
+  if(f==NULL){fprintf(stderr,"%s: No such file or directory\n",path);return 0;}
+  char magic[8];
+  if(fread(magic,1,8,f)!=8||memcmp(magic,"octotrc2",8)){fprintf(stderr,"%s: Not an instruction trace\n",path);fclose(f);return 0;}
+  t->count=octo_trace_get(f,8), t->length=octo_trace_get(f,4);
+  int len=octo_trace_get(f,4);
+  if(t->length>OCTO_TRACE_SIZE||len>=OCTO_HALT_MAX){fprintf(stderr,"%s: Malformed instruction trace\n",path);fclose(f);return 0;}
+  len=fread(t->message,1,len,f), t->message[len]='\0';
+  t->entries=malloc((t->length+1)*sizeof(octo_trace_entry));
+  for(int z=0;z<t->length;z++){
+    octo_trace_entry*r=&t->entries[z];
+    r->pc=octo_trace_get(f,2), r->op=octo_trace_get(f,2), r->i=octo_trace_get(f,2);
+    r->vx=octo_trace_get(f,1), r->vf=octo_trace_get(f,1), r->known=octo_trace_get(f,1);
+  }
+  int bad=feof(f);
+  fclose(f);
+  if(bad){fprintf(stderr,"%s: Truncated instruction trace\n",path);free(t->entries);return 0;}
+  return 1;
+}
+
+/**
+*
+*  Decoding
+*
+**/
+
+void octo_trace_disassemble(uint16_t op,char*b,int len){
+  #define OCTO_TRACE_DIS(...) {snprintf(b,len,__VA_ARGS__);return;}
+  int x=(op>>8)&0xF, y=(op>>4)&0xF, n=op&0xF, nn=op&0xFF, nnn=op&0xFFF;
+  static const char*math[]={":=","|=","&=","^=","+=","-=",">>=","=-"};
+  if(op==0x00E0)OCTO_TRACE_DIS("clear")
+  if(op==0x00EE)OCTO_TRACE_DIS("return")
+  if(op==0x00FD)OCTO_TRACE_DIS("exit")
+  if(op==0x00FE)OCTO_TRACE_DIS("lores")
+  if(op==0x00FF)OCTO_TRACE_DIS("hires")
+  if(op==0x00FB)OCTO_TRACE_DIS("scroll-right")
+  if(op==0x00FC)OCTO_TRACE_DIS("scroll-left")
+  if(op==0xF000)OCTO_TRACE_DIS("i := long")
+  if(op==0xF002)OCTO_TRACE_DIS("audio")
+  if((op&0xFFF0)==0x00C0)OCTO_TRACE_DIS("scroll-down %d",n)
+  if((op&0xFFF0)==0x00D0)OCTO_TRACE_DIS("scroll-up %d",n)
+  if((op&0xF0FF)==0xF001)OCTO_TRACE_DIS("plane %d",x)
+  if((op&0xF00F)==0x5002)OCTO_TRACE_DIS("save v%X - v%X",x,y)
+  if((op&0xF00F)==0x5003)OCTO_TRACE_DIS("load v%X - v%X",x,y)
+  if((op&0xF0FF)==0xE09E)OCTO_TRACE_DIS("if v%X -key then",x)
+  if((op&0xF0FF)==0xE0A1)OCTO_TRACE_DIS("if v%X key then",x)
+  switch(op>>12){
+    case 0x1: OCTO_TRACE_DIS("jump 0x%03X",nnn)
+    case 0x2: OCTO_TRACE_DIS(":call 0x%03X",nnn)
+    case 0x3: OCTO_TRACE_DIS("if v%X != 0x%02X then",x,nn)
+    case 0x4: OCTO_TRACE_DIS("if v%X == 0x%02X then",x,nn)
+    case 0x5: if(n==0)OCTO_TRACE_DIS("if v%X != v%X then",x,y) break;
+    case 0x6: OCTO_TRACE_DIS("v%X := 0x%02X",x,nn)
+    case 0x7: OCTO_TRACE_DIS("v%X += 0x%02X",x,nn)
+    case 0x8: if(n<8)OCTO_TRACE_DIS("v%X %s v%X",x,math[n],y)
+              if(n==0xE)OCTO_TRACE_DIS("v%X <<= v%X",x,y) break;
+    case 0x9: if(n==0)OCTO_TRACE_DIS("if v%X == v%X then",x,y) break;
+    case 0xA: OCTO_TRACE_DIS("i := 0x%03X",nnn)
+    case 0xB: OCTO_TRACE_DIS("jump0 0x%03X",nnn)
+    case 0xC: OCTO_TRACE_DIS("v%X := random 0x%02X",x,nn)
+    case 0xD: OCTO_TRACE_DIS("sprite v%X v%X %d",x,y,n)
+    case 0xF: switch(nn){
+      case 0x07: OCTO_TRACE_DIS("v%X := delay",x)
+      case 0x0A: OCTO_TRACE_DIS("v%X := key",x)
+      case 0x15: OCTO_TRACE_DIS("delay := v%X",x)
+      case 0x18: OCTO_TRACE_DIS("buzzer := v%X",x)
+      case 0x1E: OCTO_TRACE_DIS("i += v%X",x)
+      case 0x29: OCTO_TRACE_DIS("i := hex v%X",x)
+      case 0x30: OCTO_TRACE_DIS("i := bighex v%X",x)
+      case 0x33: OCTO_TRACE_DIS("bcd v%X",x)
+      case 0x3A: OCTO_TRACE_DIS("pitch := v%X",x)
+      case 0x55: OCTO_TRACE_DIS("save v%X",x)
+      case 0x65: OCTO_TRACE_DIS("load v%X",x)
+      case 0x75: OCTO_TRACE_DIS("saveflags v%X",x)
+      case 0x85: OCTO_TRACE_DIS("loadflags v%X",x)
+    }
+  }
+  OCTO_TRACE_DIS("0x%02X 0x%02X",op>>8,nn) // not an instruction
+  #undef OCTO_TRACE_DIS
+}
+
+void octo_trace_write(octo_trace_file*t,char**labels,FILE*out){
+  // one line per record, oldest first. if labels are provided,
+  // each pc is followed by the name of the nearest label.
+  char ins[64], name[8];
+  fprintf(out,"# %llu instructions traced, the last %d shown.",(unsigned long long)t->count,t->length);
+  if(t->message[0])fprintf(out," halted: %s",t->message);
+  fprintf(out,"\n#\n#        index      pc    op       i  vx  vf  instruction\n");
+  for(int z=0;z<t->length;z++){
+    octo_trace_entry*r=&t->entries[z];
+    octo_trace_disassemble(r->op,ins,sizeof(ins));
+    char i[8]="    --", vx[4]="--", vf[4]="--";
+    if(r->known&OCTO_TRACE_I )snprintf(i,sizeof(i),"0x%04X",r->i);
+    if(r->known&OCTO_TRACE_VX)snprintf(vx,sizeof(vx),"%02X",r->vx);
+    if(r->known&OCTO_TRACE_VF)snprintf(vf,sizeof(vf),"%02X",r->vf);
+    fprintf(out,"%14llu  0x%04X  %04X  %s  %s  %s  ",(unsigned long long)(t->count-t->length+z),r->pc,r->op,i,vx,vf);
+    if(labels)fprintf(out,"%-24s  ; %s\n",ins,octo_profile_label(labels,r->pc,name,sizeof(name)));
+    else      fprintf(out,"%s\n",ins);
+  }
+}
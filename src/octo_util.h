@@ -31,6 +31,8 @@ typedef struct {
   int win_scale;
   int volume;
   int show_monitors;
+  int show_profile; // 0 if hidden, otherwise the OCTO_PROFILE_BY_ column subroutines are sorted by
+  int show_stats;
 } octo_ui_config;
 octo_ui_config ui;
 
@@ -415,8 +417,10 @@ char* stralloc(char*source){
 #define EVENT_DOUBLECLICK     43
 #define EVENT_SELECT_ALL      44
 #define EVENT_BACK            45
+#define EVENT_TOGGLE_PROFILE  46
+#define EVENT_TOGGLE_STATS    47
 
-#define EVENT_MAX (1+EVENT_BACK)
+#define EVENT_MAX (1+EVENT_TOGGLE_STATS)
 
 typedef struct {
   int is_down, down_x, down_y, right_button;
@@ -475,6 +479,8 @@ void events_queue(SDL_Event*e){
     if(code==SDLK_i)input.events[EVENT_INTERRUPT]=1;
     if(code==SDLK_o)input.events[EVENT_STEP]=1;
     if(code==SDLK_m)input.events[EVENT_TOGGLE_MONITORS]=1;
+    if(code==SDLK_p)input.events[EVENT_TOGGLE_PROFILE]=1;
+    if(code==SDLK_h)input.events[EVENT_TOGGLE_STATS]=1;
     if(code==SDLK_a&&cmd)input.events[EVENT_SELECT_ALL]=1;
     if(code==SDLK_BACKQUOTE)input.events[EVENT_BACK]=1;
   }
@@ -671,13 +677,7 @@ int widget_optionbar(rect*pos,char*label,char**options,int len,int*selected){
 
 void addr_name(octo_program*prog,char* dest,int len,uint16_t addr){
   if(prog==NULL)return;
-  char*best=NULL; uint16_t best_offset=0xFFFF;
-  for(int z=0;z<prog->constants.keys.count;z++){
-    char*n=octo_list_get(&prog->constants.keys,z);
-    octo_const*c=octo_list_get(&prog->constants.values,z);
-    if(c->value==addr){best=n,best_offset=0;break;}
-    if(c->value<addr&&addr-c->value<best_offset)best=n,best_offset=addr-c->value;
-  }
+  int best_offset=0; char*best=octo_label_near(prog,addr,&best_offset);
   if     (best==NULL)    snprintf(dest,len," (unknown)");
   else if(best_offset==0)snprintf(dest,len," (%s)",best);
   else                   snprintf(dest,len," (%s + %d)",best,best_offset);
@@ -693,11 +693,8 @@ void octo_ui_registers(octo_emulator*emu,octo_program*prog){
   len=snprintf(line,1024,"pc := 0x%04X",emu->pc),addr_name(prog,line+len,1024-len,emu->pc),print;
   len=snprintf(line,1024,"i  := 0x%04X",emu->i ),addr_name(prog,line+len,1024-len,emu->i ),print;
   for(int z=0;z<16;z++){
-    int rlen=snprintf(line,1024,"v%X := 0x%02X",z,emu->v[z]), found=0;
-    if(prog!=NULL)for(int a=0;a<prog->aliases.keys.count;a++){
-      octo_reg*r=octo_list_get(&prog->aliases.values,a);
-      if(r->value==z)rlen+=snprintf(line+rlen,1024-rlen,"%s%s",(found++==0)?" ":", ",(char*)octo_list_get(&prog->aliases.keys,a));
-    }
+    int rlen=snprintf(line,1024,"v%X := 0x%02X",z,emu->v[z]);
+    if(prog!=NULL&&prog->register_aliases[z])snprintf(line+rlen,1024-rlen," %s",prog->register_aliases[z]);
     print;
   }
   y+=4;
@@ -730,6 +727,58 @@ void octo_ui_monitors(octo_emulator*emu,octo_program*prog){
   }
 }
 
+#define OCTO_STATS_FRAMES 120
+octo_frame_stats ui_stats[OCTO_STATS_FRAMES]; // per-frame counters, oldest first from ui_stats_frame
+int  ui_stats_frame=0;
+long ui_stats_count=0;    // frames retired since startup
+FILE*ui_stats_csv=NULL;   // if open, every retired frame is appended as a row
+
+octo_profile*ui_profile=NULL;
+void octo_ui_profile(octo_emulator*emu,octo_program*prog,int sort){
+  static octo_profile_call rows[4*1024];
+  static const char*columns[]={"","inclusive","exclusive","calls"};
+  if(emu->profile==NULL){
+    // start profiling when the table is first shown
+    if(ui_profile==NULL)ui_profile=malloc(sizeof(octo_profile));
+    memset(ui_profile,0,sizeof(octo_profile));
+    octo_emulator_profile(emu,ui_profile);
+  }
+  rect tb; char line[1024];
+  int n=octo_profile_calls(emu->profile,emu,rows,sort), lh=octo_mono_font.height+1;
+  int shown=MAX(0,(th-20)/lh-3), y, len;
+  if(shown>n)shown=n;
+  y=th-10-(shown+2)*lh;
+  snprintf(line,1024,"Subroutines by %s (p to sort)",columns[sort]),draw_stext(line,10,y,&tb),y+=lh+2;
+  draw_shline(10,10+300,y-2);
+  snprintf(line,1024,"inclusive exclusive   calls"),draw_stext(line,10,y,&tb),y+=lh;
+  for(int z=0;z<shown;z++){
+    len=snprintf(line,1024,"%9llu %9llu %7lu 0x%03X",(unsigned long long)rows[z].inclusive,(unsigned long long)rows[z].exclusive,(unsigned long)rows[z].calls,rows[z].addr);
+    addr_name(prog,line+len,1024-len,rows[z].addr),draw_stext(line,10,y,&tb),y+=lh;
+  }
+}
+
+void octo_ui_stats(octo_emulator*emu){
+  // one bar per recent frame, scaled to the tickrate: executed ticks,
+  // then ticks skipped in idle loops, then ticks left waiting.
+  rect tb; char line[1024];
+  int lh=octo_mono_font.height+1, bh=40, x=tw-10-2*OCTO_STATS_FRAMES, y=th-10-bh;
+  long rate=MAX(1,emu->options.tickrate);
+  rect bg={x-1,y-1,2*OCTO_STATS_FRAMES+2,bh+2};
+  draw_fill(&bg,BLACK);
+  for(int z=0;z<OCTO_STATS_FRAMES;z++){
+    octo_frame_stats*f=&ui_stats[(ui_stats_frame+z)%OCTO_STATS_FRAMES];
+    int run=(f->instructions-f->idle)*bh/rate, idle=f->idle*bh/rate, wait=f->waiting*bh/rate;
+    rect br={x+2*z,y+bh-run,2,run}, bi={br.x,br.y-idle,2,idle}, bw={br.x,bi.y-wait,2,wait};
+    draw_fill(&br,POPCOLOR);
+    draw_fill(&bi,0xFF808080);
+    draw_fill(&bw,0xFF303030);
+  }
+  octo_frame_stats*f=&ui_stats[(ui_stats_frame+OCTO_STATS_FRAMES-1)%OCTO_STATS_FRAMES];
+  y-=2*lh+4;
+  snprintf(line,1024,"%ld/%ld ticks, %ld idle, %ld waiting",f->instructions,rate,f->idle,f->waiting),draw_stext(line,x,y,&tb),y+=lh;
+  snprintf(line,1024,"%ld sprites, %ld px, %ld hits, %ld scrolls, %ld clears",f->sprites,f->pixels,f->collisions,f->scrolls,f->clears),draw_stext(line,x,y,&tb);
+}
+
 void octo_ui_init(SDL_Window*win,SDL_Renderer**ren,SDL_Texture**screen){
   if(*screen)SDL_DestroyTexture(*screen);
   if(*ren)SDL_DestroyRenderer(*ren);
@@ -737,23 +786,24 @@ void octo_ui_init(SDL_Window*win,SDL_Renderer**ren,SDL_Texture**screen){
   *screen=SDL_CreateTexture(*ren,SDL_PIXELFORMAT_ARGB8888,SDL_TEXTUREACCESS_STREAMING,128,128); // oversized for rotation
 }
 
-void octo_ui_invalidate(octo_emulator*emu){emu->ppx[0]^=0xFF;}
+void octo_ui_invalidate(octo_emulator*emu){emu->dirty=-1;}
 void octo_ui_run(octo_emulator*emu,octo_program*prog,octo_ui_config*ui,SDL_Window*win,SDL_Renderer*ren,SDL_Texture*screen,SDL_Texture*overlay){
   // drop repaints if the display hasn't changed
-  int dirty=memcmp(emu->px,emu->ppx,sizeof(emu->px))!=0, debug=emu->halt||ui->show_monitors;
-  if(!dirty&&!debug)return;
-  memcpy(emu->ppx,emu->px,sizeof(emu->ppx));
-
-  // render chip8 display
-  int *p, pitch, w=emu->hires?128:64, h=emu->hires?64:32;
-  SDL_LockTexture(screen,NULL,(void**)&p,&pitch);
-  int stride=pitch/sizeof(int);
-  if(emu->options.rotation==  0) for(int y=0;y<h;y++)for(int x=0;x<w;x++)p[x+      (y*stride)      ]=emu->options.colors[emu->px[x+(y*w)]];
-  if(emu->options.rotation== 90) for(int y=0;y<h;y++)for(int x=0;x<w;x++)p[(h-1-y)+(x*stride)      ]=emu->options.colors[emu->px[x+(y*w)]];
-  if(emu->options.rotation==180) for(int y=0;y<h;y++)for(int x=0;x<w;x++)p[(w-1-x)+((h-1-y)*stride)]=emu->options.colors[emu->px[x+(y*w)]];
-  if(emu->options.rotation==270) for(int y=0;y<h;y++)for(int x=0;x<w;x++)p[y+      ((w-1-x)*stride)]=emu->options.colors[emu->px[x+(y*w)]];
+  int debug=emu->halt||ui->show_monitors||ui->show_profile||ui->show_stats;
+  if(!emu->dirty&&!debug)return;
+
+  // render the span of chip8 display rows touched since the last repaint
+  int *p, pitch, w=emu->hires?128:64, h=emu->hires?64:32, y0=0, y1=h;
+  while(y0<h &&!((emu->dirty>>y0    )&1))y0++;
+  while(y1>y0&&!((emu->dirty>>(y1-1))&1))y1--;
+  emu->dirty=0;
+  if(y0<y1){
+    int buf[128*64], r[4];
+    octo_render(emu,y0,y1,buf,r);
+    SDL_Rect rect={r[0],r[1],r[2],r[3]};
+    SDL_UpdateTexture(screen,&rect,buf,r[2]*sizeof(int));
+  }
   if(emu->options.rotation==90||emu->options.rotation==270){int t=w;w=h,h=t;}
-  SDL_UnlockTexture(screen);
   int dw, dh, border=5;
   SDL_GetWindowSize(win,&dw,&dh);
   int sx=(dw-border)/w,sy=(dh-border)/h, scale=sx<sy?sx:sy;
@@ -763,11 +813,13 @@ void octo_ui_run(octo_emulator*emu,octo_program*prog,octo_ui_config*ui,SDL_Windo
   //render ui overlays
   if(debug){
     SDL_LockTexture(overlay,NULL,(void**)&p,&pitch);
-    stride=pitch/sizeof(int);
+    int stride=pitch/sizeof(int);
     octo_ui_begin(&emu->options,p,stride,(dw/ui->win_scale),(dh/ui->win_scale),ui->win_scale);
     memset(p,0,sizeof(int)*stride*th);
     if(emu->halt)octo_ui_registers(emu,prog);
     if(ui->show_monitors)octo_ui_monitors(emu,prog);
+    if(ui->show_profile)octo_ui_profile(emu,prog,ui->show_profile);
+    if(ui->show_stats)octo_ui_stats(emu);
     SDL_UnlockTexture(overlay);
     SDL_SetTextureBlendMode(overlay,SDL_BLENDMODE_BLEND);
     SDL_RenderCopy(ren,overlay,NULL,NULL);
@@ -973,6 +1025,8 @@ void octo_load_config(octo_ui_config*ui,octo_options*o,const char*config_path){
 void octo_load_config_default(octo_ui_config*ui,octo_options*o){
   ui->windowed=1, ui->software_render=0, ui->win_width=480, ui->win_height=272, ui->win_scale=2, ui->volume=20;
   ui->show_monitors=0;
+  ui->show_profile=0;
+  ui->show_stats=0;
   char config_path[OCTO_PATH_MAX];
   octo_path_home(config_path);
   octo_path_append(config_path,".octo.rc");
@@ -1022,13 +1076,43 @@ void audio_init(octo_emulator*emu){
 *
 **/
 
+void emu_watch(octo_emulator*emu,octo_program*prog){
+  // arm the program's :watch and :watch-read ranges, as many as fit
+  for(int z=0;z<prog->watches.count;z++){
+    octo_watch*w=octo_list_get(&prog->watches,z);
+    if(!octo_emulator_watch(emu,w->base,w->len,w->read))break;
+  }
+}
+
+void emu_stats(octo_emulator*emu){
+  // retire the counters of the frame just run
+  ui_stats[ui_stats_frame]=emu->stats;
+  ui_stats_frame=(ui_stats_frame+1)%OCTO_STATS_FRAMES;
+  if(ui_stats_csv){
+    octo_frame_stats*f=&emu->stats;
+    if(ui_stats_count==0)fprintf(ui_stats_csv,"frame,instructions,idle,waiting,sprites,pixels,collisions,scrolls,clears\n");
+    fprintf(ui_stats_csv,"%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n",ui_stats_count,
+      f->instructions,f->idle,f->waiting,f->sprites,f->pixels,f->collisions,f->scrolls,f->clears);
+  }
+  ui_stats_count++;
+  memset(&emu->stats,0,sizeof(octo_frame_stats));
+}
+
 void emu_step(octo_emulator*emu,octo_program*prog){
   if(emu->halt)return;
-  for(int z=0;z<emu->options.tickrate&&!emu->halt;z++){
+  long start=emu->ticks;
+  unsigned char*breakpoints=prog!=NULL&&prog->breaks.count?prog->breakpoints:NULL;
+  for(int z=0;z<emu->options.tickrate&&!emu->halt&&!emu->wait;z++){
     if(emu->options.q_vblank&&(emu->ram[emu->pc]&0xF0)==0xD0)z=emu->options.tickrate;
+    int pc=emu->pc;
     octo_emulator_instruction(emu);
-    if(prog!=NULL&&prog->breakpoints[emu->pc]) emu->halt=1,snprintf(emu->halt_message,OCTO_HALT_MAX,"%s",prog->breakpoints[emu->pc]);
+    if(breakpoints&&(breakpoints[emu->pc>>3]>>(emu->pc&7))&1) emu->halt=1,snprintf(emu->halt_message,OCTO_HALT_MAX,"%s",octo_breakpoint(prog,emu->pc));
+    int skipped=octo_emulator_idle(emu,pc,emu->options.tickrate-z-1);
+    z+=skipped, emu->stats.idle+=skipped;
   }
+  emu->stats.instructions=emu->ticks-start;
+  emu->stats.waiting=emu->halt?0:MAX(0,emu->options.tickrate-emu->stats.instructions);
+  emu_stats(emu);
   if(emu->dt>0)emu->dt--;
   if(emu->st>0)emu->st--,emu->had_sound=1;
 }
@@ -1037,6 +1121,299 @@ void random_init(void) {
   srand(time(NULL));
 }
 
+/**
+*
+*  Compile Cache
+*
+*  compiled programs are kept in $XDG_CACHE_HOME/octo (or
+*  ~/.cache/octo), named for a hash of the compiler version,
+*  OCTO_COMPILER_REVISION, OCTO_CACHE_REVISION (bumped whenever
+*  the layout below changes), the absolute path of the source
+*  and its text. only unoptimized programs are cached; were the
+*  output of -O/-P/-D ever kept, its passes would belong in the
+*  hash as well. includes are
+*  resolved against that path, so the same text elsewhere is a
+*  different entry. an entry holds the rom and all that the
+*  debugger needs of the program, and the absolute path, size,
+*  mtime and hash of each file it included, so that an edited
+*  include misses as well. entries are written to a temporary file and
+*  renamed into place, and once the directory grows past
+*  OCTO_CACHE_MAX bytes, the oldest are removed.
+*
+*    "octocch2"                magic
+*    u64  length of the source text
+*    string absolute path of the source
+*    u32  length, then the rom from 0x200 up to it
+*    u32  breakpoints: u16 address, string message
+*    u32  constants:   string name, f64 value, u8 is_mutable, u8 is_label
+*    u32  aliases:     string name, u8 register
+*    u32  monitors:    string name, u8 type, u16 base, u16 len, u8 has_format, string format
+*    u32  watches:     u16 base, u16 len, u8 read
+*    u32  includes:    string path, u64 size, u64 mtime, u32 hash
+*
+*  strings are a u32 length followed by their bytes, and all
+*  fields are little-endian.
+*
+**/
+
+#define OCTO_CACHE_MAX      (32*1024*1024)
+#define OCTO_CACHE_REVISION 2 // as the "octocch2" magic
+
+#ifdef _WIN32
+#define CACHE_HOME              "LOCALAPPDATA"
+#define octo_cache_mkdir(p)     CreateDirectoryA(p,NULL)
+#define octo_cache_pid()        ((long)GetCurrentProcessId())
+#define octo_cache_rename(a,b)  MoveFileExA(a,b,MOVEFILE_REPLACE_EXISTING)
+#else
+#include <unistd.h>
+#define CACHE_HOME              "XDG_CACHE_HOME"
+#define octo_cache_mkdir(p)     mkdir(p,0755)
+#define octo_cache_pid()        ((long)getpid())
+#define octo_cache_rename(a,b)  (rename(a,b)==0)
+#endif
+
+typedef struct {
+  char*  path;
+  long   size;
+  time_t mtime;
+} octo_cache_entry;
+
+int octo_cache_dir(char*path){
+  // find the cache directory, creating it if need be. 0 if there is nowhere to put it.
+  char*base=getenv(CACHE_HOME), *home=getenv(HOME);
+  path[0]='\0';
+  if     (base&&base[0])octo_path_append(path,base);
+  else if(home&&home[0])octo_path_append(path,home),octo_path_append(path,".cache");
+  else return 0;
+  octo_path_append(path,"octo");
+  for(char*c=path+1;;c++){
+    if(*c&&*c!=SEPARATOR)continue;
+    char t=*c;
+    *c='\0', octo_cache_mkdir(path), *c=t;
+    if(!t)break;
+  }
+  struct stat st;
+  return stat(path,&st)==0;
+}
+void octo_cache_absolute(char*out,const char*path){
+  // the absolute form of a path, or of the working directory for text with no path of its own
+#ifdef _WIN32
+  if(!GetFullPathNameA(path?path:".",OCTO_PATH_MAX,out,NULL))snprintf(out,OCTO_PATH_MAX,"%s",path?path:"");
+  if(!path)octo_path_append(out,"");
+#else
+  if(path&&path[0]=='/'){snprintf(out,OCTO_PATH_MAX,"%s",path);return;}
+  if(!getcwd(out,OCTO_PATH_MAX))out[0]='\0';
+  octo_path_append(out,path?(char*)path:"");
+#endif
+}
+int octo_cache_path(char*path,char*text,size_t length,char*source){
+  uint64_t h=14695981039346656037ULL;
+  char revision[64];
+  snprintf(revision,sizeof(revision),"%s/%d/%d",VERSION,OCTO_COMPILER_REVISION,OCTO_CACHE_REVISION);
+  for(char*v=revision;;v++){h=(h^(0xFF&*v))*1099511628211ULL;if(!*v)break;}
+  for(char*v=source;;v++){h=(h^(0xFF&*v))*1099511628211ULL;if(!*v)break;}
+  for(size_t z=0;z<length;z++)h=(h^(0xFF&text[z]))*1099511628211ULL;
+  char dir[OCTO_PATH_MAX];
+  if(!octo_cache_dir(dir))return 0;
+  snprintf(path,OCTO_PATH_MAX,"%s%c%016llx.8oc",dir,SEPARATOR,(unsigned long long)h);
+  return 1;
+}
+
+void octo_cache_put(FILE*f,uint64_t v,int bytes){for(int z=0;z<bytes;z++)fputc((v>>(8*z))&0xFF,f);}
+void octo_cache_put_str(FILE*f,char*s){int n=strlen(s);octo_cache_put(f,n,4),fwrite(s,1,n,f);}
+uint64_t octo_cache_get(FILE*f,int bytes){
+  uint64_t v=0;
+  for(int z=0;z<bytes;z++){int c=fgetc(f);v|=(uint64_t)(c==EOF?0:c)<<(8*z);}
+  return v;
+}
+char* octo_cache_get_str(FILE*f,octo_program*p,int*bad){
+  char buffer[OCTO_PATH_MAX];
+  int n=octo_cache_get(f,4);
+  if(n>=OCTO_PATH_MAX||(int)fread(buffer,1,n,f)!=n)return *bad=1, "";
+  return octo_intern_counted(p,buffer,n);
+}
+int octo_cache_get_match(FILE*f,char*s){
+  // does the next string read equal s?
+  char buffer[OCTO_PATH_MAX];
+  int n=octo_cache_get(f,4);
+  return n<OCTO_PATH_MAX&&(int)fread(buffer,1,n,f)==n&&n==(int)strlen(s)&&!memcmp(buffer,s,n);
+}
+
+int octo_cache_fresh(char*path,uint64_t size,uint64_t mtime,unsigned hash){
+  // is an included file as it was? a changed mtime alone is checked against the text.
+  struct stat st;
+  if(stat(path,&st)||(uint64_t)st.st_size!=size)return 0;
+  if((uint64_t)st.st_mtime==mtime)return 1;
+  FILE*f=fopen(path,"rb");
+  if(f==NULL)return 0;
+  char*text=malloc(size+1);
+  size_t n=fread(text,1,size,f);
+  fclose(f);
+  int fresh=n==size&&octo_include_hash(text,n)==hash;
+  free(text);
+  return fresh;
+}
+
+octo_program* octo_cache_load(char*text,size_t length,const char*source_path){
+  // the program compiled from text at source_path before, or NULL.
+  char path[OCTO_PATH_MAX], source[OCTO_PATH_MAX], magic[8];
+  octo_cache_absolute(source,source_path);
+  if(!octo_cache_path(path,text,length,source))return NULL;
+  FILE*f=fopen(path,"rb");
+  if(f==NULL)return NULL;
+  if(fread(magic,1,8,f)!=8||memcmp(magic,"octocch2",8)||octo_cache_get(f,8)!=length||!octo_cache_get_match(f,source)){fclose(f);return NULL;}
+  octo_program*p=octo_program_init_buffer("",0,0);
+  int bad=0;
+  p->length=octo_cache_get(f,4);
+  if(p->length<0x200||p->length>OCTO_RAM_MAX)p->length=0x200, bad=1;
+  if(fread(p->rom+0x200,1,p->length-0x200,f)!=(size_t)(p->length-0x200))bad=1;
+  for(int n=octo_cache_get(f,4),z=0;z<n&&!bad;z++){
+    int a=octo_cache_get(f,2);
+    octo_set_breakpoint(p,a,octo_cache_get_str(f,p,&bad));
+  }
+  for(int n=octo_cache_get(f,4),z=0;z<n&&!bad;z++){
+    char*name=octo_cache_get_str(f,p,&bad);
+    uint64_t bits=octo_cache_get(f,8);
+    octo_const*c=octo_make_const(0,0);
+    memcpy(&c->value,&bits,sizeof(double)), c->is_mutable=octo_cache_get(f,1), c->is_label=octo_cache_get(f,1);
+    free(octo_map_set(&p->constants,name,c));
+  }
+  for(int n=octo_cache_get(f,4),z=0;z<n&&!bad;z++){
+    char*name=octo_cache_get_str(f,p,&bad);
+    free(octo_map_set(&p->aliases,name,octo_make_reg(octo_cache_get(f,1))));
+  }
+  for(int n=octo_cache_get(f,4),z=0;z<n&&!bad;z++){
+    char*name=octo_cache_get_str(f,p,&bad);
+    octo_mon*m=octo_make_mon();
+    m->type=octo_cache_get(f,1), m->base=octo_cache_get(f,2), m->len=octo_cache_get(f,2);
+    m->format=octo_cache_get(f,1)?octo_cache_get_str(f,p,&bad):NULL;
+    octo_free_mon(octo_map_set(&p->monitors,name,m));
+  }
+  for(int n=octo_cache_get(f,4),z=0;z<n&&!bad;z++){
+    int base=octo_cache_get(f,2), len=octo_cache_get(f,2);
+    octo_list_append(&p->watches,octo_make_watch(base,len,octo_cache_get(f,1)));
+  }
+  for(int n=octo_cache_get(f,4),z=0;z<n&&!bad;z++){
+    char*include=octo_cache_get_str(f,p,&bad);
+    uint64_t size=octo_cache_get(f,8), mtime=octo_cache_get(f,8);
+    if(!octo_cache_fresh(include,size,mtime,octo_cache_get(f,4)))bad=1;
+  }
+  bad|=feof(f)||ferror(f)||p->is_error;
+  fclose(f);
+  if(bad){octo_free_program(p);return NULL;}
+  octo_index_program(p);
+  return p;
+}
+
+int octo_cache_entry_cmp(const void*a,const void*b){
+  const octo_cache_entry*x=a, *y=b;
+  return x->mtime<y->mtime?-1: x->mtime>y->mtime?1: strcmp(x->path,y->path);
+}
+void octo_cache_evict(char*dir){
+  // remove the oldest entries until the rest fit in OCTO_CACHE_MAX
+  octo_list names;
+  octo_list_init(&names);
+#ifdef _WIN32
+  char wildcard[OCTO_PATH_MAX]="\0";
+  octo_path_append(wildcard,dir);
+  octo_path_append(wildcard,"*.8oc");
+  WIN32_FIND_DATAA find;
+  HANDLE d=FindFirstFileA(wildcard,&find);
+  if(d!=INVALID_HANDLE_VALUE){
+    do{octo_list_append(&names,strcpy(malloc(strlen(find.cFileName)+1),find.cFileName));}while(FindNextFileA(d,&find));
+    FindClose(d);
+  }
+#else
+  DIR*d=opendir(dir);
+  struct dirent*find;
+  while(d&&(find=readdir(d))){
+    int n=strlen(find->d_name);
+    if(n>4&&!strcmp(find->d_name+n-4,".8oc"))octo_list_append(&names,strcpy(malloc(n+1),find->d_name));
+  }
+  if(d)closedir(d);
+#endif
+  octo_cache_entry*entries=calloc(names.count+1,sizeof(octo_cache_entry));
+  long total=0; int n=0;
+  for(int z=0;z<names.count;z++){
+    char path[OCTO_PATH_MAX]="\0";
+    struct stat st;
+    octo_path_append(path,dir), octo_path_append(path,octo_list_get(&names,z));
+    if(stat(path,&st))continue;
+    entries[n].path=strcpy(malloc(strlen(path)+1),path), entries[n].size=st.st_size, entries[n].mtime=st.st_mtime;
+    total+=entries[n++].size;
+  }
+  qsort(entries,n,sizeof(octo_cache_entry),octo_cache_entry_cmp);
+  for(int z=0;z<n;z++){
+    if(total>OCTO_CACHE_MAX&&remove(entries[z].path)==0)total-=entries[z].size;
+    free(entries[z].path);
+  }
+  free(entries);
+  octo_list_destroy(&names,free);
+}
+
+void octo_cache_save(octo_program*p,char*text,size_t length,const char*source_path){
+  char path[OCTO_PATH_MAX], source[OCTO_PATH_MAX], include[OCTO_PATH_MAX], temp[OCTO_PATH_MAX+32];
+  octo_cache_absolute(source,source_path);
+  if(p->is_error||!octo_cache_path(path,text,length,source))return;
+  snprintf(temp,sizeof(temp),"%s.%ld.tmp",path,octo_cache_pid());
+  FILE*f=fopen(temp,"wb");
+  if(f==NULL)return;
+  fwrite("octocch2",1,8,f);
+  octo_cache_put(f,length,8);
+  octo_cache_put_str(f,source);
+  octo_cache_put(f,p->length,4), fwrite(p->rom+0x200,1,p->length-0x200,f);
+  octo_cache_put(f,p->breaks.count,4);
+  for(int z=0;z<p->breaks.count;z++){
+    octo_break*b=octo_list_get(&p->breaks,z);
+    octo_cache_put(f,b->addr,2), octo_cache_put_str(f,b->message);
+  }
+  octo_cache_put(f,p->constants.keys.count,4);
+  for(int z=0;z<p->constants.keys.count;z++){
+    octo_const*c=octo_list_get(&p->constants.values,z);
+    uint64_t bits; memcpy(&bits,&c->value,sizeof(double));
+    octo_cache_put_str(f,octo_list_get(&p->constants.keys,z));
+    octo_cache_put(f,bits,8), octo_cache_put(f,c->is_mutable,1), octo_cache_put(f,c->is_label,1);
+  }
+  octo_cache_put(f,p->aliases.keys.count,4);
+  for(int z=0;z<p->aliases.keys.count;z++){
+    octo_cache_put_str(f,octo_list_get(&p->aliases.keys,z));
+    octo_cache_put(f,((octo_reg*)octo_list_get(&p->aliases.values,z))->value,1);
+  }
+  octo_cache_put(f,p->monitors.keys.count,4);
+  for(int z=0;z<p->monitors.keys.count;z++){
+    octo_mon*m=octo_list_get(&p->monitors.values,z);
+    octo_cache_put_str(f,octo_list_get(&p->monitors.keys,z));
+    octo_cache_put(f,m->type,1), octo_cache_put(f,m->base,2), octo_cache_put(f,m->len,2), octo_cache_put(f,m->format!=NULL,1);
+    if(m->format)octo_cache_put_str(f,m->format);
+  }
+  octo_cache_put(f,p->watches.count,4);
+  for(int z=0;z<p->watches.count;z++){
+    octo_watch*w=octo_list_get(&p->watches,z);
+    octo_cache_put(f,w->base,2), octo_cache_put(f,w->len,2), octo_cache_put(f,w->read,1);
+  }
+  octo_cache_put(f,p->files.count-1,4);
+  for(int z=1;z<p->files.count;z++){
+    octo_included*c=octo_include_find(((octo_file*)octo_list_get(&p->files,z))->path);
+    octo_cache_absolute(include,c->path);
+    octo_cache_put_str(f,include);
+    octo_cache_put(f,c->size,8), octo_cache_put(f,c->mtime,8), octo_cache_put(f,c->hash,4);
+  }
+  int ok=!ferror(f);
+  ok&=fclose(f)==0;
+  if(!ok||!octo_cache_rename(temp,path))remove(temp);
+  char dir[OCTO_PATH_MAX];
+  if(octo_cache_dir(dir))octo_cache_evict(dir);
+}
+
+octo_program* octo_cache_compile(char*text,size_t length,int owned,const char*path){
+  // compile text, or fetch the program it compiled to before. as octo_program_init_buffer, if owned, the text is freed.
+  octo_program*p=octo_cache_load(text,length,path);
+  if(p){if(owned)free(text);return p;}
+  p=octo_compile_program(octo_program_path(octo_program_init_buffer(text,length,owned),path));
+  octo_cache_save(p,text,length,path);
+  return p;
+}
+
 /**
 *
 *  Source Files
@@ -1047,46 +1424,54 @@ void octo_load_program(octo_ui_config*ui,octo_emulator*emu,octo_program**prog,co
   octo_options defaults;
   octo_load_config_default(ui,&defaults);
   if(options)octo_load_config(ui,&defaults,options);
-  char*source;
-  struct stat st;
-  if(stat(filename,&st)!=0){
+  int rom=strcmp(".ch8",filename+(strlen(filename)-4))==0, text=strcmp(".8o",filename+(strlen(filename)-3))==0;
+  octo_source source;
+  if((rom||text)&&!octo_source_open(&source,filename)){
     fprintf(stderr,"%s: No such file or directory\n",filename);
     exit(1);
   }
-  size_t source_size=st.st_size;
-
-  if(strcmp(".ch8",filename+(strlen(filename)-4))==0){
-    source=malloc(source_size+1);
-    FILE*source_file=fopen(filename,"rb");
-    fread(source,sizeof(char),source_size,source_file);
-    fclose(source_file);
-    octo_emulator_init(emu, source, source_size, &defaults, NULL);
+
+  if(rom){
+    octo_emulator_init(emu,source.data,source.size,&defaults,NULL);
+    octo_source_close(&source);
   }
-  else if(strcmp(".8o",filename+(strlen(filename)-3))==0){
-    source=malloc(source_size+1);
-    FILE*source_file=fopen(filename,"rb");
-    fread(source,sizeof(char),source_size,source_file);
-    source[source_size]='\0';
-    fclose(source_file);
-    octo_program*p=(*prog)=octo_compile_str(source);
+  else if(text){
+    octo_program*p=(*prog)=octo_cache_compile(source.data,source.size,0,filename);
+    octo_source_close(&source);
     if(p->is_error){
+      if(octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
       fprintf(stderr,"(%d:%d) %s\n",p->error_line+1,p->error_pos+1,p->error);
       octo_free_program(p),exit(1);
     }
     octo_emulator_init(emu,p->rom+0x200,p->length-0x200,&defaults,NULL);
+    emu_watch(emu,p);
   }
   else if(strcmp(".gif",filename+(strlen(filename)-4))==0){
-    char* source=octo_cart_load(filename,&defaults);
+    char*rom=NULL; int rom_size=0;
+    char* source=octo_cart_load_rom(filename,&defaults,&rom,&rom_size);
     if(source==NULL){
       fprintf(stderr,"%s: Unable to load octocart\n",filename);
       exit(1);
     }
-    octo_program*p=(*prog)=octo_compile_str(source);
+    // the source gives the debugger its symbols. only if it no longer compiles does the cart's own rom run, as a .ch8 would.
+    octo_program*p=octo_cache_compile(source,strlen(source),1,filename);
+    if(p->is_error&&rom!=NULL){
+      if(octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
+      fprintf(stderr,"(%d:%d) %s; running the octocart's compiled rom\n",p->error_line+1,p->error_pos+1,p->error);
+      octo_free_program(p);
+      octo_emulator_init(emu,rom,rom_size,&defaults,NULL);
+      free(rom);
+      return;
+    }
+    free(rom);
+    (*prog)=p;
     if(p->is_error){
+      if(octo_error_file(p))fprintf(stderr,"%s: ",octo_error_file(p));
       fprintf(stderr,"(%d:%d) %s\n",p->error_line+1,p->error_pos+1,p->error);
       octo_free_program(p),exit(1);
     }
     octo_emulator_init(emu,p->rom+0x200,p->length-0x200,&defaults,NULL);
+    emu_watch(emu,p);
   }
   else {
     fprintf(stderr,"source file must be a .ch8 or .8o\n");